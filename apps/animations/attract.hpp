@@ -42,37 +42,14 @@
 #include "../../lib/luxigrid.h"
 
 #include "../../lib/animation-helpers.hpp"
-#include "../../lib/Vector.h"
-#include "../../lib/Boid.h"
-
-class Attractor {
-	public:
-	float mass;        // Mass, tied to size
-	float G;           // Gravitational Constant
-	PVector location;  // Location
-
-	Attractor() {
-		location = PVector(MATRIX_CENTER_X, MATRIX_CENTER_Y);
-		mass = 10;
-		G = .5;
-	}
-
-	PVector attract(Boid m) {
-		PVector force = location - m.location;           // Calculate direction of force
-		float d = force.mag();                           // Distance between objects
-		d = constrain(d, 5.0, 32.0);                     // Limiting the distance to eliminate "extreme" results for very close or very far objects
-		force.normalize();                               // Normalize vector (distance doesn't matter here, we just want this vector for direction)
-		float strength = (G * mass * m.mass) / (d * d);  // Calculate gravitational force magnitude
-		force *= strength;                               // Get force vector --> magnitude * direction
-		return force;
-	}
-};
+#include "../../lib/particles.hpp"
 
-static const uint8_t AVAILABLE_BOID_COUNT = 40;
-Boid boids[AVAILABLE_BOID_COUNT];
+// The attractor sits in the middle of the panel
+const float attractorMass = 10;
+const float gravitationalConstant = .5;
 
 const uint8_t count = 12;
-Attractor attractor;
+ParticleSystem<count> boids;
 
 ///////////////////
 // SETUP FUNCTION
@@ -84,7 +61,7 @@ void setup() {
 	// Allocate memory for the leds data structure, and set the FastLED palette
 	leds = (CRGB *)malloc(NUM_LEDS * sizeof(CRGB));
 	memset(leds, 0x00, NUM_LEDS * sizeof(CRGB));
-	currentPalette = RainbowColors_p;
+	setPalette(RainbowColors_p);
 	last_frame = millis();
 
 	int direction = random(0, 2);
@@ -93,13 +70,11 @@ void setup() {
 	}
 
 	for (int i = 0; i < count; i++) {
-		Boid boid = Boid(15, 31 - i);
-		boid.mass = 1;
-		boid.velocity.x = ((float)random(40, 50)) / 100.0;
-		boid.velocity.x *= direction;
-		boid.velocity.y = 0;
-		boid.colorIndex = i * 32;
-		boids[i] = boid;
+		boids.add(15, 31 - i);
+		boids.vx[i] = ((float)random(40, 50)) / 100.0;
+		boids.vx[i] *= direction;
+		boids.vy[i] = 0;
+		boids.colour[i] = i * 32;
 	}
 }
 
@@ -120,17 +95,11 @@ void loop() {
 			leds[i].nscale8(dim);
 		}
 
-		for (int i = 0; i < count; i++) {
-			Boid boid = boids[i];
-
-			PVector force = attractor.attract(boid);
-			boid.applyForce(force);
-
-			boid.update();
-
-			leds[XY16(boid.location.x, boid.location.y)] = ColorFromPalette(currentPalette, boid.colorIndex);
+		applyAttractor(boids, MATRIX_CENTER_X, MATRIX_CENTER_Y, attractorMass, gravitationalConstant);
+		boids.integrate();
 
-			boids[i] = boid;
+		for (int i = 0; i < boids.count; i++) {
+			leds[XY16(boids.x[i], boids.y[i])] = paletteLookup(boids.colour[i]);
 		}
 
 		updateScreen();
@@ -42,44 +42,11 @@
 #include "../../lib/luxigrid.h"
 
 #include "../../lib/animation-helpers.hpp"
-
-const uint8_t noisesmoothing = 200;
+#include "../../lib/noise-field.hpp"
 
 int16_t dx, dy, dz, dsx, dsy;
-uint32_t noise_x, noise_y, noise_z;
-
-uint32_t noise_scale_x = 6000;
-uint32_t noise_scale_y = 6000;
-
-// Memory will be allocated for this later
-uint8_t **noise = nullptr;
-
-void ShowNoiseLayer(byte layer, byte colorrepeat, byte colorshift) {
-	for (uint16_t i = 0; i < MATRIX_WIDTH; i++) {
-		for (uint16_t j = 0; j < MATRIX_HEIGHT; j++) {
-			uint8_t pixel = noise[i][j];
-			leds[XY16(i, j)] = ColorFromPalette(currentPalette, colorrepeat * (pixel + colorshift), pixel);
-		}
-	}
-}
-
-void FillNoise() {
-	for (uint16_t i = 0; i < MATRIX_WIDTH; i++) {
-		uint32_t ioffset = noise_scale_x * (i - MATRIX_CENTER_Y);
-
-		for (uint16_t j = 0; j < MATRIX_HEIGHT; j++) {
-			uint32_t joffset = noise_scale_y * (j - MATRIX_CENTER_Y);
 
-			byte data = inoise16(noise_x + ioffset, noise_y + joffset, noise_z) >> 8;
-
-			uint8_t olddata = noise[i][j];
-			uint8_t newdata = scale8(olddata, noisesmoothing) + scale8(data, 256 - noisesmoothing);
-			data = newdata;
-
-			noise[i][j] = data;
-		}
-	}
-}
+NoiseField noiseField;
 
 ///////////////////
 // SETUP FUNCTION
@@ -90,26 +57,18 @@ void setup() {
 	// Allocate memory for the leds data structure, and set the FastLED palette
 	leds = (CRGB *)malloc(NUM_LEDS * sizeof(CRGB));
 	memset(leds, 0x00, NUM_LEDS * sizeof(CRGB));
-	currentPalette = RainbowColors_p;
+	setPalette(RainbowColors_p);
 	last_frame = millis();
 
-	// Allocate memory for the noise effect
-	// Original Comment: (there should be some guards for malloc errors eventually)
-	noise = (uint8_t **)malloc(MATRIX_WIDTH * sizeof(uint8_t *));
-
-	for (int i = 0; i < MATRIX_WIDTH; ++i) {
-		noise[i] = (uint8_t *)malloc(MATRIX_HEIGHT * sizeof(uint8_t));
-	}
-
 	dx = random8();
 	dy = random8();
 	dz = random8();
 	dsx = random8();
 	dsy = random8();
 
-	noise_x = random16();
-	noise_y = random16();
-	noise_z = random16();
+	noiseField.x = random16();
+	noiseField.y = random16();
+	noiseField.z = random16();
 }
 
 ///////////////////
@@ -127,16 +86,16 @@ void loop() {
 			dy = random16(500) - 250;
 			dx = random16(500) - 250;
 			dz = random16(500) - 250;
-			noise_scale_x = random16(10000) + 2000;
-			noise_scale_y = random16(10000) + 2000;
+			noiseField.scaleX = random16(10000) + 2000;
+			noiseField.scaleY = random16(10000) + 2000;
 		}
 
-		noise_y += dy;
-		noise_x += dx;
-		noise_z += dz;
+		noiseField.y += dy;
+		noiseField.x += dx;
+		noiseField.z += dz;
 
-		FillNoise();
-		ShowNoiseLayer(0, 1, 0);
+		noiseField.fill();
+		noiseField.show(1, 0);
 		updateScreen();
 		last_frame = millis();
 	}
@@ -44,16 +44,14 @@
 #include "../../lib/luxigrid.h"
 
 #include "../../lib/animation-helpers.hpp"
-#include "../../lib/Vector.h"
-#include "../../lib/Boid.h"
+#include "../../lib/particles.hpp"
 
-static const uint8_t AVAILABLE_BOID_COUNT = 40;
-Boid boids[AVAILABLE_BOID_COUNT];
+static const uint16_t boidCount = 64;
+ParticleSystem<boidCount> boids;
+ParticleSystem<1> predator;
+ParticleGrid boidGrid;
 
-static const int boidCount = 10;
-Boid predator;
-
-PVector wind;
+float windX, windY;
 byte hue = 0;
 bool predatorPresent = true;
 
@@ -66,25 +64,23 @@ void setup() {
 	// Allocate memory for the leds data structure, and set the FastLED palette
 	leds = (CRGB *)malloc(NUM_LEDS * sizeof(CRGB));
 	memset(leds, 0x00, NUM_LEDS * sizeof(CRGB));
-	currentPalette = RainbowColors_p;
+	setPalette(RainbowColors_p);
 	last_frame = millis();
 
+	boids.maxSpeed = 0.380;
+	boids.maxForce = 0.015;
+
 	for (int i = 0; i < boidCount; i++) {
-		boids[i] = Boid(15, 15);
-		boids[i].maxspeed = 0.380;
-		boids[i].maxforce = 0.015;
+		boids.add(15, 15);
 	}
 
-	predatorPresent = random(0, 2) >= 1;
+	predator.maxSpeed = 0.385;
+	predator.maxForce = 0.020;
+	predator.neighbourDistance = 16.0;
+	predator.desiredSeparation = 0.0;
+	predator.add(31, 31);
 
-	if (predatorPresent) {
-		predator = Boid(31, 31);
-		predatorPresent = true;
-		predator.maxspeed = 0.385;
-		predator.maxforce = 0.020;
-		predator.neighbordist = 16.0;
-		predator.desiredseparation = 0.0;
-	}
+	predatorPresent = random(0, 2) >= 1;
 }
 
 ///////////////////
@@ -104,40 +100,43 @@ void loop() {
 
 		updateScreen();
 
-		bool applyWind = random(0, 255) > 250;
+		bool gust = random(0, 255) > 250;
 
-		if (applyWind) {
-			wind.x = Boid::randomf() * .015;
-			wind.y = Boid::randomf() * .015;
+		if (gust) {
+			windX = boids.randomVelocity() * .015;
+			windY = boids.randomVelocity() * .015;
 		}
 
-		CRGB color = ColorFromPalette(currentPalette, hue);
+		// Flee from predator, flock, and move
+		boidGrid.build(boids);
 
-		for (int i = 0; i < boidCount; i++) {
-			Boid *boid = &boids[i];
+		if (predatorPresent) {
+			applyRepulsion(boids, predator.x[0], predator.y[0], 10);
+		}
+
+		applyFlocking(boids, boids, boidGrid);
 
-			// Flee from predator
-			if (predatorPresent) {
-				boid->repelForce(predator.location, 10);
-			}
+		if (gust) {
+			applyWind(boids, windX, windY);
+		}
 
-			boid->run(boids, boidCount);
-			boid->wrapAroundBorders();
-			PVector location = boid->location;
-			leds[XY16(location.x, location.y)] = color;
+		boids.integrate();
+		boids.wrapAroundBorders();
 
-			if (applyWind) {
-				boid->applyForce(wind);
-				applyWind = false;
-			}
+		CRGB color = paletteLookup(hue);
+
+		for (int i = 0; i < boids.count; i++) {
+			leds[XY16(boids.x[i], boids.y[i])] = color;
 		}
 
+		// The predator chases the flock where it is now
 		if (predatorPresent) {
-			predator.run(boids, boidCount);
+			boidGrid.build(boids);
+			applyFlocking(predator, boids, boidGrid);
+			predator.integrate();
 			predator.wrapAroundBorders();
-			color = ColorFromPalette(currentPalette, hue + 128);
-			PVector location = predator.location;
-			leds[XY16(location.x, location.y)] = color;
+
+			leds[XY16(predator.x[0], predator.y[0])] = paletteLookup(hue + 128);
 		}
 
 		EVERY_N_MILLIS(200) {
@@ -35,11 +35,7 @@
 #include "../../lib/luxigrid.h"
 
 #include "../../lib/animation-helpers.hpp"
-#include "../../lib/Vector.h"
-#include "../../lib/Boid.h"
-
-static const uint8_t AVAILABLE_BOID_COUNT = 40;
-Boid boids[AVAILABLE_BOID_COUNT];
+#include "../../lib/particles.hpp"
 
 uint16_t x;
 uint16_t y;
@@ -48,6 +44,7 @@ uint16_t z;
 const uint16_t speed = 1;
 const uint16_t scale = 26;
 static const int count = 40;
+ParticleSystem<count> boids;
 
 byte hue = 0;
 
@@ -60,7 +57,7 @@ void setup() {
 	// Allocate memory for the leds data structure, and set the FastLED palette
 	leds = (CRGB *)malloc(NUM_LEDS * sizeof(CRGB));
 	memset(leds, 0x00, NUM_LEDS * sizeof(CRGB));
-	currentPalette = RainbowColors_p;
+	setPalette(RainbowColors_p);
 	last_frame = millis();
 
 	x = random16();
@@ -68,7 +65,7 @@ void setup() {
 	z = random16();
 
 	for (int i = 0; i < count; i++) {
-		boids[i] = Boid(random(MATRIX_WIDTH), 0);
+		boids.add(random(MATRIX_WIDTH), 0);
 	}
 }
 
@@ -87,23 +84,15 @@ void loop() {
 			leds[i].nscale8(240);
 		}
 
-		for (int i = 0; i < count; i++) {
-			Boid *boid = &boids[i];
-
-			int ioffset = scale * boid->location.x;
-			int joffset = scale * boid->location.y;
-
-			byte angle = inoise8(x + ioffset, y + joffset, z);
-
-			boid->velocity.x = (float)sin8(angle) * 0.0078125 - 1.0;
-			boid->velocity.y = -((float)cos8(angle) * 0.0078125 - 1.0);
-			boid->update();
+		steerByNoise(boids, x, y, z, scale, hue);
+		boids.integrate();
 
-			leds[XY16(boid->location.x, boid->location.y)] = ColorFromPalette(currentPalette, angle + hue);
+		for (int i = 0; i < boids.count; i++) {
+			leds[XY16(boids.x[i], boids.y[i])] = paletteLookup(boids.colour[i]);
 
-			if (boid->location.x < 0 || boid->location.x >= MATRIX_WIDTH || boid->location.y < 0 || boid->location.y >= MATRIX_HEIGHT) {
-				boid->location.x = random(MATRIX_WIDTH);
-				boid->location.y = 0;
+			if (boids.isOffScreen(i)) {
+				boids.x[i] = random(MATRIX_WIDTH);
+				boids.y[i] = 0;
 			}
 		}
 
@@ -54,7 +54,7 @@ void setup() {
 	// Allocate memory for the leds data structure, and set the FastLED palette
 	leds = (CRGB *)malloc(NUM_LEDS * sizeof(CRGB));
 	memset(leds, 0x00, NUM_LEDS * sizeof(CRGB));
-	currentPalette = RainbowColors_p;
+	setPalette(RainbowColors_p);
 	last_frame = millis();
 }
 
@@ -76,7 +76,7 @@ void loop() {
 		}
 
 		for (int i = 2; i <= MATRIX_WIDTH / 2; i++) {
-			CRGB color = ColorFromPalette(currentPalette, (i - 2) * (240 / (MATRIX_WIDTH / 2)));
+			CRGB color = paletteLookup((i - 2) * (240 / (MATRIX_WIDTH / 2)));
 
 			uint8_t x = beatcos8((17 - i) * 2, MATRIX_CENTER_X - i, MATRIX_CENTER_X + i);
 			uint8_t y = beatsin8((17 - i) * 2, MATRIX_CENTER_Y - i, MATRIX_CENTER_Y + i);
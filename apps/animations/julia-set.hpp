@@ -37,6 +37,8 @@
 #include "Arduino.h"
 #include "../../lib/luxigrid.h"
 
+#include "../../lib/animation-helpers.hpp"
+
 // Cast float as int32_t
 int32_t intfloat(float n) {
 	return *(int32_t *)&n;
@@ -52,16 +54,6 @@ float floatsqrt(float n) {
 	return floatint(0x1fbb4000 + (intfloat(n) >> 1));
 }
 
-// Fast approx 1/x
-float floatinv(float n) {
-	return floatint(0x7f000000 - intfloat(n));
-}
-
-// Fast approx log2(x)
-float floatlog2(float n) {
-	return (float)((intfloat(n) << 1) - 0x7f000000) * 5.9604645e-08f;
-}
-
 // Escape time mandelbrot set function,
 // with arbitrary start point zx, zy
 // and arbitrary seed point ax, ay
@@ -74,39 +66,97 @@ float floatlog2(float n) {
 // zx = 0, zy = 0;
 // ax = pos_x,  ay = pos_y;
 
+// The maths is done in Q7.24 fixed point, which has about the same precision as a float but keeps the inner loop in integer registers
+// Nothing gets bigger than about 50 before it escapes, so 7 integer bits are plenty
+#define JULIA_FRACTION_BITS 24
+
 // Escape radius
-const float bailOut = 4;
+const int32_t bailOut = 4 << JULIA_FRACTION_BITS;
 
 // Colour speed
 const int32_t itmult = 1 << 10;
 
-// Precalculated sin table, for performance reasons
-float sint[256];
+// Points that haven't escaped are compared against a saved point, which is replaced every checkPeriod iterations (with the period doubling each time)
+// If the orbit comes back to within this distance of it, the point is inside the set, so there's no need to keep going
+const int32_t periodicityTolerance = 1 << (JULIA_FRACTION_BITS - 16);
+const uint16_t firstCheckPeriod = 8;
+
+// Colour lookup table, indexed by the low 12 bits of the colour value (the palette repeats after that)
+#define JULIA_COLOURS 4096
+
+struct JuliaColour {
+	uint8_t r, g, b;
+};
+
+JuliaColour juliaColours[JULIA_COLOURS];
+
+#define JULIA_FPS 60
+
+unsigned long lastJuliaFrame = 0;
+
+// The parameters for the frame being drawn
+int32_t frameSeedX, frameSeedY;
+uint32_t frameColourOffset;
+
+inline int32_t fixedMultiply(int32_t a, int32_t b) {
+	return ((int64_t)a * b) >> JULIA_FRACTION_BITS;
+}
+
+// Fast approx log2(x), for a positive fixed point x, in 16.16 format
+// Like a float's exponent and mantissa, this is the position of the top bit plus the (linearly interpolated) bits below it
+int32_t fixedlog2(int32_t n) {
+	if (n <= 0) {
+		n = 1;
+	}
+
+	int msb = 31 - __builtin_clz(n);
+	int32_t mantissa = msb >= 16 ? (n >> (msb - 16)) & 0xffff : (n << (16 - msb)) & 0xffff;
+
+	return ((msb - JULIA_FRACTION_BITS) << 16) + mantissa;
+}
 
 // https://en.wikipedia.org/wiki/Mandelbrot_set
-int32_t iteratefloat(float ax, float ay, float zx, float zy, uint16_t mxIT) {
-	float zzl = 0;
+int32_t iteratefixed(int32_t ax, int32_t ay, int32_t zx, int32_t zy, uint16_t mxIT) {
+	int32_t zzl = 0;
+
+	int32_t checkX = zx, checkY = zy;
+	uint16_t checkPeriod = firstCheckPeriod;
+	uint16_t sinceCheck = 0;
 
 	for (int it = 0; it < mxIT; it++) {
-		float zzx = zx * zx;
-		float zzy = zy * zy;
+		int32_t zzx = fixedMultiply(zx, zx);
+		int32_t zzy = fixedMultiply(zy, zy);
 
 		// Is the point escaped?
+		// (All the start points are well within the escape radius, so this never happens on the first iteration)
 		if (zzx + zzy >= bailOut) {
-			if (it > 0) {
-				// Calculate smooth colouring
-				float zza = floatlog2(zzl);
-				float zzb = floatlog2(zzx + zzy);
-				float zzc = floatlog2(bailOut);
-				float zzd = (zzc - zza) * floatinv(zzb - zza);
-
-				return it * itmult + zzd * itmult;
+			// Calculate smooth colouring
+			int32_t zza = fixedlog2(zzl);
+			int32_t zzb = fixedlog2(zzx + zzy);
+			int32_t zzc = fixedlog2(bailOut);
+
+			if (zzb <= zza) {
+				return it * itmult;
 			}
-		};
 
-		zy = 2.f * zx * zy + ay;
+			return it * itmult + (((int64_t)(zzc - zza) * itmult) / (zzb - zza));
+		}
+
+		zy = (fixedMultiply(zx, zy) << 1) + ay;
 		zx = zzx - zzy + ax;
 		zzl = zzx + zzy;
+
+		// Periodicity checking
+		if (abs(zx - checkX) + abs(zy - checkY) < periodicityTolerance) {
+			return 0;
+		}
+
+		if (++sinceCheck == checkPeriod) {
+			checkX = zx;
+			checkY = zy;
+			checkPeriod <<= 1;
+			sinceCheck = 0;
+		}
 	}
 
 	return 0;
@@ -116,20 +166,34 @@ int32_t iteratefloat(float ax, float ay, float zx, float zy, uint16_t mxIT) {
 // https://editor.p5js.org/Kouzerumatsukite/sketches/DwTiq9D01
 // color palette originally made by piano_miles, written in p5js
 // hsv2rgb(IT, cos(4096*it)/2+0.5, 1-sin(2048*it)/2-0.5)
-void drawPixelPalette(int x, int y, uint32_t m) {
-	float r = 0.f, g = 0.f, b = 0.f;
+// Only the low 12 bits of m affect the colour, so this is worked out once for each of them in setup()
+JuliaColour paletteColour(uint32_t m, const float *sint) {
+	char n = m >> 4;
+	float l = abs(sint[m >> 2 & 255]) * 255.f;
+	float s = (sint[m & 255] + 1.f) * 0.5f;
 
-	if (m) {
-		char n = m >> 4;
-		float l = abs(sint[m >> 2 & 255]) * 255.f;
-		float s = (sint[m & 255] + 1.f) * 0.5f;
+	float r = (max(min(sint[n & 255] + 0.5f, 1.f), 0.f) * s + (1 - s)) * l;
+	float g = (max(min(sint[n + 85 & 255] + 0.5f, 1.f), 0.f) * s + (1 - s)) * l;
+	float b = (max(min(sint[n + 170 & 255] + 0.5f, 1.f), 0.f) * s + (1 - s)) * l;
 
-		r = (max(min(sint[n & 255] + 0.5f, 1.f), 0.f) * s + (1 - s)) * l;
-		g = (max(min(sint[n + 85 & 255] + 0.5f, 1.f), 0.f) * s + (1 - s)) * l;
-		b = (max(min(sint[n + 170 & 255] + 0.5f, 1.f), 0.f) * s + (1 - s)) * l;
-	}
+	return {(uint8_t)r, (uint8_t)g, (uint8_t)b};
+}
+
+void drawJuliaRow(uint8_t y) {
+	// Pixel coordinates map to ((x - 64) + 1) / 64 and y / 64
+	int32_t zy = (int32_t)y << (JULIA_FRACTION_BITS - 6);
 
-	dma_display->drawPixelRGB888(x, y, r, g, b);
+	for (uint8_t x = 0; x < PANEL_RES_X; x++) {
+		int32_t zx = ((int32_t)x - 63) * (1 << (JULIA_FRACTION_BITS - 6));
+		uint32_t itcount = iteratefixed(frameSeedX, frameSeedY, zx, zy, 64);
+
+		if (itcount) {
+			const JuliaColour &colour = juliaColours[((uint32_t)(floatsqrt(itcount) * 4) + frameColourOffset) & (JULIA_COLOURS - 1)];
+			dma_display->drawPixelRGB888(x, y, colour.r, colour.g, colour.b);
+		} else {
+			dma_display->drawPixelRGB888(x, y, 0, 0, 0);
+		}
+	}
 }
 
 void drawCanvas() {
@@ -141,14 +205,16 @@ void drawCanvas() {
 	float xoff = (cos(t) * cosk + k / 2 - 0.25);
 	float yoff = (sin(t) * cosk);
 
-	for (uint8_t y = 0; y < PANEL_RES_Y; y++) {
-		for (uint8_t x = 0; x < PANEL_RES_X; x++) {
-			uint32_t itcount = iteratefloat(xoff, yoff, ((x - 64) + 1) / 64.f, (y) / 64.f, 64);
-			uint32_t itcolor = itcount ? floatsqrt(itcount) * 4 + t * 1024 : 0;
+	frameSeedX = xoff * (1 << JULIA_FRACTION_BITS);
+	frameSeedY = yoff * (1 << JULIA_FRACTION_BITS);
+	frameColourOffset = t * 1024;
 
-			drawPixelPalette(x, y, itcolor);
-		}
-	}
+	// The panel is scanned two rows at a time (y and y + PANEL_RES_Y / 2), and both rows' pixels share the same words in the DMA buffer
+	// So each core draws a pair of those rows at a time, and they never write to the same word
+	parallelFor(PANEL_RES_Y / 2, [](uint16_t y) {
+		drawJuliaRow(y);
+		drawJuliaRow(y + PANEL_RES_Y / 2);
+	});
 }
 
 ///////////////////
@@ -157,10 +223,16 @@ void drawCanvas() {
 void setup() {
 	setupMatrix();
 
-	// Precalculate the sine table
+	// Precalculate the sine table, and from it the colour table
+	float sint[256];
+
 	for (int i = 0; i < 256; i++) {
 		sint[i] = sinf(i / 256.f * 2.f * PI);
 	}
+
+	for (int i = 0; i < JULIA_COLOURS; i++) {
+		juliaColours[i] = paletteColour(i, sint);
+	}
 }
 
 ///////////////////
@@ -173,7 +245,11 @@ void loop() {
 		return;
 	}
 
-	drawCanvas();
+	if (millis() - lastJuliaFrame >= 1000 / JULIA_FPS) {
+		lastJuliaFrame = millis();
+		drawCanvas();
+	}
+
 	delay(1);
 }
 
@@ -46,46 +46,211 @@
 #include "../../lib/Vector.h"
 #include "../../lib/Boid.h"
 
-class Cell {
-	public:
-	byte alive : 1;
-	byte prev : 1;
-	byte hue : 6;
-	byte brightness;
+// The world is bit-packed, with one 64-bit word per row and column x in bit x
+// A whole row's next generation is worked out at once with bitwise adders, instead of counting neighbours cell by cell
+// LIFE_ROWS can be taller than the panel, in which case the panel shows the top MATRIX_HEIGHT rows of a bigger (still toroidal) world
+#ifndef LIFE_ROWS
+#define LIFE_ROWS MATRIX_HEIGHT
+#endif
+
+static_assert(MATRIX_WIDTH == 64, "The Life engine packs each row of the panel into a single 64-bit word");
+static_assert(LIFE_ROWS >= MATRIX_HEIGHT, "The Life world can't be shorter than the panel");
+
+typedef uint64_t LifeRow;
+
+struct LifeGrid {
+	LifeRow rows[LIFE_ROWS];
 };
 
-Cell world[MATRIX_WIDTH][MATRIX_HEIGHT];
+// Two grids, swapped every generation, so there's no copy pass
+LifeGrid lifeGrids[2];
+uint8_t currentGrid = 0;
+
+// The colour/fade layer, kept separate from the simulation
+// Every birth moves a cell's hue along a little; dead cells fade out over a few frames
+uint8_t cellHue[MATRIX_HEIGHT][MATRIX_WIDTH];
+uint8_t cellBrightness[MATRIX_HEIGHT][MATRIX_WIDTH];
 
 const unsigned int density = 50;
 int generation = 0;
 
-void regenerateWorld() {
-	for (int i = 0; i < MATRIX_WIDTH; i++) {
-		for (int j = 0; j < MATRIX_HEIGHT; j++) {
+// Reset after this many generations even if the world is still changing (otherwise it gets boring pretty quickly)
+#define LIFE_MAX_GENERATIONS 256
+
+// How many past generations to remember; a still life or any cycle shorter than this is caught as soon as it starts repeating
+#define LIFE_HISTORY_LENGTH 16
+
+// When enabled, candidate worlds are simulated ahead of time on the other core, and only ones that keep going for
+// LIFE_MAX_GENERATIONS without settling down are shown
+#ifndef LIFE_SOUP_SEARCH
+#define LIFE_SOUP_SEARCH true
+#endif
+
+// How many vetted worlds to keep ready
+#define LIFE_SOUP_QUEUE_LENGTH 2
+
+// Rotating (rather than shifting) wraps the edges around, so the world is a torus
+inline LifeRow rotateRowLeft(LifeRow row) {
+	return (row << 1) | (row >> 63);
+}
+
+inline LifeRow rotateRowRight(LifeRow row) {
+	return (row >> 1) | (row << 63);
+}
+
+// Work out the next generation of one row, given the rows above and below it
+// Each bit position is an independent little counter; the eight neighbours are added up with half and full adders
+LifeRow nextLifeRow(LifeRow above, LifeRow row, LifeRow below) {
+	LifeRow aboveLeft = rotateRowLeft(above), aboveRight = rotateRowRight(above);
+	LifeRow rowLeft = rotateRowLeft(row), rowRight = rotateRowRight(row);
+	LifeRow belowLeft = rotateRowLeft(below), belowRight = rotateRowRight(below);
+
+	// Sum each group of three (or two) neighbours into a ones bit and a twos bit
+	LifeRow aboveOnes = aboveLeft ^ above ^ aboveRight;
+	LifeRow aboveTwos = (aboveLeft & above) | (aboveRight & (aboveLeft ^ above));
+	LifeRow rowOnes = rowLeft ^ rowRight;
+	LifeRow rowTwos = rowLeft & rowRight;
+	LifeRow belowOnes = belowLeft ^ below ^ belowRight;
+	LifeRow belowTwos = (belowLeft & below) | (belowRight & (belowLeft ^ below));
+
+	// Add the ones bits together, carrying into the twos
+	LifeRow ones = aboveOnes ^ rowOnes ^ belowOnes;
+	LifeRow onesCarry = (aboveOnes & rowOnes) | (belowOnes & (aboveOnes ^ rowOnes));
+
+	// Add the four twos bits together; anything that carries into the fours means at least four neighbours
+	LifeRow twosSum = aboveTwos ^ rowTwos ^ belowTwos;
+	LifeRow twosCarry = (aboveTwos & rowTwos) | (belowTwos & (aboveTwos ^ rowTwos));
+	LifeRow twos = twosSum ^ onesCarry;
+	LifeRow fours = twosCarry | (twosSum & onesCarry);
+
+	// Three neighbours (ones and twos set) gives birth or survival; two neighbours (twos only) keeps a live cell alive
+	return twos & ~fours & (ones | row);
+}
+
+void stepLife(const LifeGrid &current, LifeGrid &next) {
+	for (int y = 0; y < LIFE_ROWS; y++) {
+		LifeRow above = current.rows[y == 0 ? LIFE_ROWS - 1 : y - 1];
+		LifeRow below = current.rows[y == LIFE_ROWS - 1 ? 0 : y + 1];
+
+		next.rows[y] = nextLifeRow(above, current.rows[y], below);
+	}
+}
+
+// Hashes of recent generations, in a small ring
+class LifeHistory {
+	public:
+	void clear() {
+		count = 0;
+		next = 0;
+	}
+
+	// Remembers this generation, and returns true if it has been seen recently (i.e. the world is stuck in a cycle)
+	bool repeats(const LifeGrid &grid) {
+		uint64_t hash = hashGrid(grid);
+
+		for (uint8_t i = 0; i < count; i++) {
+			if (hashes[i] == hash) {
+				return true;
+			}
+		}
+
+		hashes[next] = hash;
+		next = (next + 1) % LIFE_HISTORY_LENGTH;
+
+		if (count < LIFE_HISTORY_LENGTH) {
+			count++;
+		}
+
+		return false;
+	}
+
+	private:
+	// FNV-1a, a word at a time rather than a byte at a time
+	static uint64_t hashGrid(const LifeGrid &grid) {
+		uint64_t hash = 0xcbf29ce484222325;
+
+		for (int y = 0; y < LIFE_ROWS; y++) {
+			hash = (hash ^ grid.rows[y]) * 0x100000001b3;
+		}
+
+		return hash;
+	}
+
+	uint64_t hashes[LIFE_HISTORY_LENGTH];
+	uint8_t count = 0;
+	uint8_t next = 0;
+};
+
+LifeHistory lifeHistory;
+
+QueueHandle_t lifeSoupQueue = NULL;
+
+void seedLifeGrid(LifeGrid &grid) {
+	for (int y = 0; y < LIFE_ROWS; y++) {
+		grid.rows[y] = 0;
+
+		for (int x = 0; x < MATRIX_WIDTH; x++) {
 			if (random(100) < density) {
-				world[i][j].alive = 1;
-				world[i][j].brightness = 255;
-			} else {
-				world[i][j].alive = 0;
-				world[i][j].brightness = 0;
+				grid.rows[y] |= (LifeRow)1 << x;
 			}
+		}
+	}
+}
+
+// Run a candidate world off-screen, and check that it doesn't settle into a still life or short cycle before it would be reset anyway
+bool lifeSoupSurvives(const LifeGrid &seed) {
+	LifeGrid grids[2];
+	LifeHistory history;
+	uint8_t current = 0;
+
+	grids[0] = seed;
+	history.repeats(grids[0]);
 
-			world[i][j].prev = world[i][j].alive;
-			world[i][j].hue = 0;
+	for (int i = 0; i < LIFE_MAX_GENERATIONS; i++) {
+		stepLife(grids[current], grids[current ^ 1]);
+		current ^= 1;
+
+		if (history.repeats(grids[current])) {
+			return false;
 		}
 	}
+
+	return true;
 }
 
-// Check how many neighours a given cell has
-int neighbours(int x, int y) {
-	return (world[(x + 1) % MATRIX_WIDTH][y].prev) +
-	       (world[x][(y + 1) % MATRIX_HEIGHT].prev) +
-	       (world[(x + MATRIX_WIDTH - 1) % MATRIX_WIDTH][y].prev) +
-	       (world[x][(y + MATRIX_HEIGHT - 1) % MATRIX_HEIGHT].prev) +
-	       (world[(x + 1) % MATRIX_WIDTH][(y + 1) % MATRIX_HEIGHT].prev) +
-	       (world[(x + MATRIX_WIDTH - 1) % MATRIX_WIDTH][(y + 1) % MATRIX_HEIGHT].prev) +
-	       (world[(x + MATRIX_WIDTH - 1) % MATRIX_WIDTH][(y + MATRIX_HEIGHT - 1) % MATRIX_HEIGHT].prev) +
-	       (world[(x + 1) % MATRIX_WIDTH][(y + MATRIX_HEIGHT - 1) % MATRIX_HEIGHT].prev);
+// Keeps the soup queue topped up with worlds that are known to last; blocks while the queue is full
+void runLifeSoupSearch(void *pvParameters) {
+	LifeGrid candidate;
+
+	for (;;) {
+		seedLifeGrid(candidate);
+
+		if (lifeSoupSurvives(candidate)) {
+			xQueueSend(lifeSoupQueue, &candidate, portMAX_DELAY);
+		}
+
+		// Give the other tasks on this core a look in between candidates
+		vTaskDelay(1);
+	}
+}
+
+void regenerateWorld() {
+	LifeGrid &grid = lifeGrids[currentGrid];
+
+	// Use a vetted world if one is ready, otherwise fall back to a fresh random one
+	if (lifeSoupQueue == NULL || xQueueReceive(lifeSoupQueue, &grid, 0) != pdTRUE) {
+		seedLifeGrid(grid);
+	}
+
+	lifeHistory.clear();
+	lifeHistory.repeats(grid);
+
+	for (int y = 0; y < MATRIX_HEIGHT; y++) {
+		for (int x = 0; x < MATRIX_WIDTH; x++) {
+			cellHue[y][x] = 0;
+			cellBrightness[y][x] = (grid.rows[y] >> x) & 1 ? 255 : 0;
+		}
+	}
 }
 
 void setup() {
@@ -94,8 +259,22 @@ void setup() {
 	// Allocate memory for the leds data structure, and set the FastLED palette
 	leds = (CRGB *)malloc(NUM_LEDS * sizeof(CRGB));
 	memset(leds, 0x00, NUM_LEDS * sizeof(CRGB));
-	currentPalette = RainbowColors_p;
+	setPalette(RainbowColors_p);
 	last_frame = millis();
+
+	if (LIFE_SOUP_SEARCH) {
+		lifeSoupQueue = xQueueCreate(LIFE_SOUP_QUEUE_LENGTH, sizeof(LifeGrid));
+
+		xTaskCreatePinnedToCore(
+		    runLifeSoupSearch,   /* Task function */
+		    "runLifeSoupSearch", /* Name of the task, for debugging purposes */
+		    4096,                /* Stack size for the task; it holds a couple of grids */
+		    NULL,                /* Parameter to pass to the task */
+		    0,                   /* Task priority (lower than the background tasks) */
+		    NULL,                /* Task handle */
+		    0                    /* Core where the task should run (away from the render loop) */
+		);
+	}
 }
 
 void loop() {
@@ -113,45 +292,39 @@ void loop() {
 		}
 
 		// Display the current generation
-		for (int i = 0; i < MATRIX_WIDTH; i++) {
-			for (int j = 0; j < MATRIX_HEIGHT; j++) {
-				leds[XY16(i, j)] = ColorFromPalette(currentPalette, world[i][j].hue * 4, world[i][j].brightness);
+		for (int y = 0; y < MATRIX_HEIGHT; y++) {
+			for (int x = 0; x < MATRIX_WIDTH; x++) {
+				leds[XY16(x, y)] = paletteLookup((cellHue[y][x] & 63) * 4, cellBrightness[y][x]);
 			}
 		}
 
 		// Birth and death cycle
-		for (int x = 0; x < MATRIX_WIDTH; x++) {
-			for (int y = 0; y < MATRIX_HEIGHT; y++) {
-				// Default is for each cell to stay the same
-				if (world[x][y].brightness > 0 && world[x][y].prev == 0) {
-					world[x][y].brightness *= 0.9;
-				}
+		const LifeGrid &current = lifeGrids[currentGrid];
+		LifeGrid &next = lifeGrids[currentGrid ^ 1];
+		stepLife(current, next);
 
-				int count = neighbours(x, y);
+		// Update the colour layer for the visible rows; only births and dead cells that are still fading need touching
+		for (int y = 0; y < MATRIX_HEIGHT; y++) {
+			LifeRow born = next.rows[y] & ~current.rows[y];
+			LifeRow fading = ~current.rows[y] & ~born;
 
-				if (count == 3 && world[x][y].prev == 0) {
+			for (int x = 0; x < MATRIX_WIDTH; x++) {
+				if ((born >> x) & 1) {
 					// A new cell is born
-					world[x][y].alive = 1;
-					world[x][y].hue += 2;
-					world[x][y].brightness = 255;
-				} else if ((count < 2 || count > 3) && world[x][y].prev == 1) {
-					// Cell dies
-					world[x][y].alive = 0;
+					cellHue[y][x] += 2;
+					cellBrightness[y][x] = 255;
+				} else if ((fading >> x) & 1 && cellBrightness[y][x] > 0) {
+					cellBrightness[y][x] = cellBrightness[y][x] * 9 / 10;
 				}
 			}
 		}
 
-		// Copy next generation into place
-		for (int x = 0; x < MATRIX_WIDTH; x++) {
-			for (int y = 0; y < MATRIX_HEIGHT; y++) {
-				world[x][y].prev = world[x][y].alive;
-			}
-		}
-
+		currentGrid ^= 1;
 		generation++;
 
-		// Reset the generation after a number of cycles (otherwise it gets boring pretty quickly)
-		if (generation >= 256) {
+		// Reseed straight away if the world has settled into a still life or a short cycle,
+		// and otherwise after a number of generations
+		if (lifeHistory.repeats(next) || generation >= LIFE_MAX_GENERATIONS) {
 			generation = 0;
 		}
 
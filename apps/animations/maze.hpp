@@ -42,6 +42,30 @@
 
 #include "../../lib/animation-helpers.hpp"
 
+// The maze can be bigger than the screen, in which case the view scrolls to follow whatever is happening
+// Each cell takes up 2x2 pixels: the cell itself, the passages to its right and below, and a corner that's always a wall
+#ifndef MAZE_WIDTH
+#define MAZE_WIDTH MATRIX_WIDTH
+#endif
+
+#ifndef MAZE_HEIGHT
+#define MAZE_HEIGHT (MATRIX_HEIGHT / 2)
+#endif
+
+#define MAZE_CELLS (MAZE_WIDTH * MAZE_HEIGHT)
+#define MAZE_PIXEL_WIDTH (MAZE_WIDTH * 2)
+#define MAZE_PIXEL_HEIGHT (MAZE_HEIGHT * 2)
+
+static_assert(MAZE_CELLS <= 65535, "Cells are indexed with uint16_t, so a maze can have at most 65535 of them");
+
+// Each frame runs up to MAZE_STEPS_PER_SECOND worth of steps, but never for longer than MAZE_FRAME_BUDGET microseconds
+// Steps that don't change anything on screen (Wilson's random walks) only count against the time budget
+#define MAZE_STEPS_PER_SECOND 300
+#define MAZE_FRAME_BUDGET 4000
+
+// How long the solved maze stays on screen before the next one starts, in milliseconds
+#define MAZE_HOLD_TIME 3000
+
 enum Directions {
 	None = 0,
 	Up = 1,
@@ -50,160 +74,530 @@ enum Directions {
 	Right = 8,
 };
 
-struct Point {
-	int x;
-	int y;
+// The low four bits of mazeCells are the directions a cell has passages in
+#define MAZE_IN_MAZE 16
+#define MAZE_SEEN 32
 
-	static Point New(int x, int y) {
-		Point point;
-		point.x = x;
-		point.y = y;
-		return point;
-	}
+enum MazeAlgorithm {
+	MAZE_BACKTRACKER,
+	MAZE_PRIM,
+	MAZE_WILSON,
+	MAZE_ALGORITHM_COUNT,
+};
 
-	Point Move(Directions direction) {
-		switch (direction) {
-			case Up:
-				return New(x, y - 1);
-			case Down:
-				return New(x, y + 1);
-			case Left:
-				return New(x - 1, y);
-			case Right:
-			default:
-				return New(x + 1, y);
-		}
-	}
+enum MazePhase {
+	MAZE_GENERATING,
+	MAZE_SOLVING,
+	MAZE_TRACING,
+	MAZE_HOLDING,
+};
 
-	static Directions Opposite(Directions direction) {
-		switch (direction) {
-			case Up:
-				return Down;
-			case Down:
-				return Up;
-			case Left:
-				return Right;
-			case Right:
-			default:
-				return Left;
-		}
-	}
+enum MazePixel : uint8_t {
+	MAZE_WALL,
+	MAZE_CARVED,
+	MAZE_SEARCHED,
+	MAZE_SOLUTION,
 };
 
-static const int width = MATRIX_WIDTH / 2;
-static const int height = MATRIX_HEIGHT / 2;
+uint8_t mazeCells[MAZE_CELLS];
+
+// The pixels of the whole maze, drawn into as it's generated and solved, and copied to the screen a window at a time
+uint8_t mazeHue[MAZE_PIXEL_HEIGHT][MAZE_PIXEL_WIDTH];
+MazePixel mazePixels[MAZE_PIXEL_HEIGHT][MAZE_PIXEL_WIDTH];
+
+// Growing tree: the cells that may still have unvisited neighbours
+// Wilson's: the cells that aren't part of the maze yet, with listPosition saying where each one is in the list
+// Solver: the BFS queue, or the A* open list as a binary heap
+uint16_t cellList[MAZE_CELLS];
+uint16_t listPosition[MAZE_CELLS];
+uint16_t cellCount = 0;
+uint16_t queueHead = 0;
+
+// Wilson's: the direction the random walk last left each cell in
+// Solver: the direction back towards the start
+Directions cellDirection[MAZE_CELLS];
 
-Directions grid[width][height];
+// Solver: the length of the path from the start to each cell
+uint16_t pathLength[MAZE_CELLS];
 
-Point point;
+MazeAlgorithm algorithm = MAZE_BACKTRACKER;
+MazePhase phase = MAZE_GENERATING;
+bool useAStar = false;
 
-Point cells[256];
-int cellCount = 0;
+uint16_t activeCell = 0;
+uint16_t walkStart = 0;
+bool walking = false;
+bool carvingWalk = false;
 
-int algorithm = 0;
-int algorithmCount = 1;
+const uint16_t startCell = 0;
+const uint16_t goalCell = MAZE_CELLS - 1;
+
+float viewX = 0;
+float viewY = 0;
+
+float stepCredit = 0;
+unsigned long phaseStartTime = 0;
 
 byte hue = 0;
 byte hueOffset = 0;
 
-Directions directions[4] = {Up, Down, Left, Right};
+const Directions directions[4] = {Up, Down, Left, Right};
 
-// Shift cells after the specified index down by one
-void removeCell(int index) {
-	for (int i = index; i < cellCount - 1; i++) {
-		cells[i] = cells[i + 1];
-	}
+uint16_t cellX(uint16_t cell) {
+	return cell % MAZE_WIDTH;
+}
+
+uint16_t cellY(uint16_t cell) {
+	return cell / MAZE_WIDTH;
+}
 
-	cellCount--;
+Directions opposite(Directions direction) {
+	switch (direction) {
+		case Up:
+			return Down;
+		case Down:
+			return Up;
+		case Left:
+			return Right;
+		case Right:
+		default:
+			return Left;
+	}
 }
 
-void shuffleDirections() {
-	for (int a = 0; a < 4; a++) {
-		int r = random(a, 4);
-		Directions temp = directions[a];
-		directions[a] = directions[r];
-		directions[r] = temp;
+// Returns false if moving that way would leave the maze
+bool neighbour(uint16_t cell, Directions direction, uint16_t &next) {
+	uint16_t x = cellX(cell);
+	uint16_t y = cellY(cell);
+
+	switch (direction) {
+		case Up:
+			if (y == 0) return false;
+			next = cell - MAZE_WIDTH;
+			return true;
+		case Down:
+			if (y == MAZE_HEIGHT - 1) return false;
+			next = cell + MAZE_WIDTH;
+			return true;
+		case Left:
+			if (x == 0) return false;
+			next = cell - 1;
+			return true;
+		case Right:
+		default:
+			if (x == MAZE_WIDTH - 1) return false;
+			next = cell + 1;
+			return true;
 	}
 }
 
-Point createPoint(int x, int y) {
-	Point point;
-	point.x = x;
-	point.y = y;
-	return point;
+void setCellPixel(uint16_t cell, MazePixel state, uint8_t h) {
+	uint16_t x = cellX(cell) * 2;
+	uint16_t y = cellY(cell) * 2;
+
+	mazePixels[y][x] = state;
+	mazeHue[y][x] = h;
 }
 
-CRGB chooseColor(int index) {
-	byte h = index + hueOffset;
+// The pixel between a cell and its neighbour in the given direction
+void setPassagePixel(uint16_t cell, Directions direction, MazePixel state, uint8_t h) {
+	uint16_t x = cellX(cell) * 2;
+	uint16_t y = cellY(cell) * 2;
 
-	switch (algorithm) {
-		case 0:
+	switch (direction) {
+		case Up:
+			y--;
+			break;
+		case Down:
+			y++;
+			break;
+		case Left:
+			x--;
+			break;
+		case Right:
 		default:
-			return ColorFromPalette(currentPalette, h);
-		case 1:
-			return ColorFromPalette(currentPalette, hue++);
+			x++;
+			break;
 	}
+
+	mazePixels[y][x] = state;
+	mazeHue[y][x] = h;
 }
 
-int chooseIndex(int max) {
-	switch (algorithm) {
-		case 0:
-		default:
-			// Choose newest (recursive backtracker)
-			return max - 1;
-		case 1:
-			// Choose random(Prim's)
-			return random(max);
+void carvePassage(uint16_t cell, Directions direction, uint16_t next, uint8_t h) {
+	mazeCells[cell] |= direction | MAZE_IN_MAZE;
+	mazeCells[next] |= opposite(direction) | MAZE_IN_MAZE;
+
+	setPassagePixel(cell, direction, MAZE_CARVED, h);
+	setCellPixel(next, MAZE_CARVED, h);
+}
+
+// Removes the entry at position from cellList in constant time, by moving the last entry into its place
+void swapRemove(uint16_t position) {
+	uint16_t last = cellList[--cellCount];
+
+	cellList[position] = last;
+	listPosition[last] = position;
+}
+
+///////////////////
+// GENERATION
+///////////////////
+// Recursive backtracker and Prim's are both the growing tree algorithm; they only differ in which cell they grow from
+bool stepGrowingTree() {
+	if (cellCount == 0) {
+		return false;
+	}
+
+	uint16_t position = algorithm == MAZE_BACKTRACKER ? cellCount - 1 : random(cellCount);
+	uint16_t cell = cellList[position];
+	activeCell = cell;
+
+	// Pick one of the unvisited neighbours at random
+	Directions candidates[4];
+	uint16_t candidateCells[4];
+	uint8_t candidateCount = 0;
+
+	for (Directions direction : directions) {
+		uint16_t next;
+
+		if (neighbour(cell, direction, next) && !(mazeCells[next] & MAZE_IN_MAZE)) {
+			candidates[candidateCount] = direction;
+			candidateCells[candidateCount++] = next;
+		}
+	}
+
+	if (candidateCount == 0) {
+		swapRemove(position);
+		return true;
 	}
+
+	uint8_t choice = random(candidateCount);
+	uint8_t h = algorithm == MAZE_BACKTRACKER ? cellCount + hueOffset : hue++;
+
+	carvePassage(cell, candidates[choice], candidateCells[choice], h);
+
+	listPosition[candidateCells[choice]] = cellCount;
+	cellList[cellCount++] = candidateCells[choice];
+
+	return true;
 }
 
-void drawNextCell() {
-	int index = chooseIndex(cellCount);
+void addToMaze(uint16_t cell) {
+	mazeCells[cell] |= MAZE_IN_MAZE;
+	swapRemove(listPosition[cell]);
+}
 
-	if (index < 0)
-		return;
+// Wilson's algorithm: random walk from a cell outside the maze until the walk hits the maze, then carve the walk into it
+// The walk only remembers the last direction it left each cell in, which erases any loops it made along the way
+bool stepWilson() {
+	if (carvingWalk) {
+		uint16_t cell = activeCell;
+		Directions direction = cellDirection[cell];
+		uint16_t next;
+
+		neighbour(cell, direction, next);
+		bool reachedMaze = mazeCells[next] & MAZE_IN_MAZE;
+
+		if (cell == walkStart) {
+			setCellPixel(cell, MAZE_CARVED, hue);
+		}
+
+		addToMaze(cell);
+		carvePassage(cell, direction, next, hue++);
+
+		activeCell = next;
+
+		if (reachedMaze) {
+			carvingWalk = false;
+			walking = false;
+		}
+
+		return true;
+	}
 
-	point = cells[index];
+	if (!walking) {
+		if (cellCount == 0) {
+			return false;
+		}
 
-	Point imagePoint = createPoint(point.x * 2, point.y * 2);
+		walkStart = cellList[random(cellCount)];
+		activeCell = walkStart;
+		walking = true;
+	}
 
-	shuffleDirections();
+	Directions direction;
+	uint16_t next;
 
-	CRGB color = chooseColor(index);
+	do {
+		direction = directions[random(4)];
+	} while (!neighbour(activeCell, direction, next));
 
-	for (int i = 0; i < 4; i++) {
-		Directions direction = directions[i];
+	cellDirection[activeCell] = direction;
+	activeCell = next;
 
-		Point newPoint = point.Move(direction);
-		if (newPoint.x >= 0 && newPoint.y >= 0 && newPoint.x < width && newPoint.y < height && grid[newPoint.y][newPoint.x] == None) {
-			grid[point.y][point.x] = (Directions)((int)grid[point.y][point.x] | (int)direction);
-			grid[newPoint.y][newPoint.x] = (Directions)((int)grid[newPoint.y][newPoint.x] | (int)point.Opposite(direction));
+	if (mazeCells[next] & MAZE_IN_MAZE) {
+		carvingWalk = true;
+		activeCell = walkStart;
+	}
 
-			Point newImagePoint = imagePoint.Move(direction);
+	return false;
+}
 
-			leds[XY16(newImagePoint.x, newImagePoint.y)] = color;
+///////////////////
+// SOLVING
+///////////////////
+uint16_t distanceToGoal(uint16_t cell) {
+	return (MAZE_WIDTH - 1 - cellX(cell)) + (MAZE_HEIGHT - 1 - cellY(cell));
+}
+
+uint16_t heapKey(uint16_t position) {
+	return pathLength[cellList[position]] + distanceToGoal(cellList[position]);
+}
 
-			cellCount++;
-			cells[cellCount - 1] = newPoint;
+void heapPush(uint16_t cell) {
+	uint16_t position = cellCount++;
+	cellList[position] = cell;
 
-			index = -1;
+	while (position > 0) {
+		uint16_t parent = (position - 1) / 2;
+
+		if (heapKey(parent) <= heapKey(position)) {
 			break;
 		}
+
+		std::swap(cellList[parent], cellList[position]);
+		position = parent;
 	}
+}
+
+uint16_t heapPop() {
+	uint16_t top = cellList[0];
+	cellList[0] = cellList[--cellCount];
+
+	uint16_t position = 0;
 
-	if (index > -1) {
-		Point finishedPoint = cells[index];
-		imagePoint = createPoint(finishedPoint.x * 2, finishedPoint.y * 2);
+	for (;;) {
+		uint16_t smallest = position;
+		uint16_t left = position * 2 + 1;
+		uint16_t right = left + 1;
 
-		leds[XY16(imagePoint.x, imagePoint.y)] = color;
+		if (left < cellCount && heapKey(left) < heapKey(smallest)) smallest = left;
+		if (right < cellCount && heapKey(right) < heapKey(smallest)) smallest = right;
+
+		if (smallest == position) {
+			break;
+		}
 
-		removeCell(index);
+		std::swap(cellList[smallest], cellList[position]);
+		position = smallest;
 	}
+
+	return top;
 }
 
-void generateMaze() {
-	while (cellCount > 1) {
-		drawNextCell();
+void startSolving() {
+	phase = MAZE_SOLVING;
+	cellCount = 0;
+	queueHead = 0;
+
+	mazeCells[startCell] |= MAZE_SEEN;
+	pathLength[startCell] = 0;
+
+	if (useAStar) {
+		heapPush(startCell);
+	} else {
+		cellList[cellCount++] = startCell;
+	}
+}
+
+// Breadth-first search, or A* with the Manhattan distance to the goal, one cell at a time
+bool stepSolver() {
+	uint16_t cell = useAStar ? heapPop() : cellList[queueHead++];
+	activeCell = cell;
+
+	mazePixels[cellY(cell) * 2][cellX(cell) * 2] = MAZE_SEARCHED;
+
+	if (cell == goalCell) {
+		phase = MAZE_TRACING;
+		return true;
+	}
+
+	for (Directions direction : directions) {
+		uint16_t next;
+
+		if (!(mazeCells[cell] & direction) || !neighbour(cell, direction, next) || (mazeCells[next] & MAZE_SEEN)) {
+			continue;
+		}
+
+		mazeCells[next] |= MAZE_SEEN;
+		cellDirection[next] = opposite(direction);
+		pathLength[next] = pathLength[cell] + 1;
+
+		setPassagePixel(cell, direction, MAZE_SEARCHED, mazeHue[cellY(cell) * 2][cellX(cell) * 2]);
+
+		if (useAStar) {
+			heapPush(next);
+		} else {
+			cellList[cellCount++] = next;
+		}
+	}
+
+	return true;
+}
+
+// Follow the solver's directions back from the goal, lighting up the path
+bool stepTrace() {
+	uint16_t cell = activeCell;
+	setCellPixel(cell, MAZE_SOLUTION, 0);
+
+	if (cell == startCell) {
+		phase = MAZE_HOLDING;
+		phaseStartTime = millis();
+		return true;
+	}
+
+	Directions direction = cellDirection[cell];
+	setPassagePixel(cell, direction, MAZE_SOLUTION, 0);
+	neighbour(cell, direction, activeCell);
+
+	return true;
+}
+
+///////////////////
+// MAZE ENGINE
+///////////////////
+void startMaze() {
+	memset(mazeCells, 0, sizeof(mazeCells));
+	memset(mazePixels, MAZE_WALL, sizeof(mazePixels));
+
+	hue = 0;
+	hueOffset = random(0, 256);
+
+	phase = MAZE_GENERATING;
+	stepCredit = 0;
+
+	uint16_t first = random(MAZE_CELLS);
+	activeCell = first;
+
+	if (algorithm == MAZE_WILSON) {
+		// Every cell starts outside the maze, apart from the first one
+		for (uint16_t cell = 0; cell < MAZE_CELLS; cell++) {
+			cellList[cell] = cell;
+			listPosition[cell] = cell;
+		}
+
+		cellCount = MAZE_CELLS;
+		walking = false;
+		carvingWalk = false;
+
+		addToMaze(first);
+	} else {
+		cellList[0] = first;
+		listPosition[first] = 0;
+		cellCount = 1;
+
+		mazeCells[first] |= MAZE_IN_MAZE;
+	}
+
+	setCellPixel(first, MAZE_CARVED, hueOffset);
+}
+
+// Runs one step of whatever phase the maze is in; returns true if it changed anything on screen
+bool stepMaze() {
+	switch (phase) {
+		case MAZE_GENERATING: {
+			bool changed = algorithm == MAZE_WILSON ? stepWilson() : stepGrowingTree();
+
+			if (cellCount == 0 && !carvingWalk) {
+				startSolving();
+			}
+
+			return changed;
+		}
+
+		case MAZE_SOLVING:
+			return stepSolver();
+
+		case MAZE_TRACING:
+			return stepTrace();
+
+		case MAZE_HOLDING:
+		default:
+			return false;
+	}
+}
+
+// Run as many steps as this frame's share of MAZE_STEPS_PER_SECOND allows, stopping early if the time budget runs out
+void advanceMaze(unsigned long elapsed) {
+	unsigned long startTime = micros();
+
+	stepCredit = min(stepCredit + elapsed * MAZE_STEPS_PER_SECOND / 1000.0f, (float)MAZE_STEPS_PER_SECOND);
+
+	while (stepCredit >= 1 && phase != MAZE_HOLDING && micros() - startTime < MAZE_FRAME_BUDGET) {
+		if (stepMaze()) {
+			stepCredit--;
+		}
+	}
+
+	if (phase == MAZE_HOLDING && millis() - phaseStartTime >= MAZE_HOLD_TIME) {
+		algorithm = (MazeAlgorithm)((algorithm + 1) % MAZE_ALGORITHM_COUNT);
+
+		// Alternate the solver once every generation algorithm has had a turn
+		if (algorithm == 0) {
+			useAStar = !useAStar;
+		}
+
+		startMaze();
+	}
+}
+
+// Ease the view towards whatever cell is currently active, and copy that window of the maze to the screen
+void drawMaze() {
+	float targetX = constrain((float)cellX(activeCell) * 2 - MATRIX_WIDTH / 2, 0.0f, (float)max(0, MAZE_PIXEL_WIDTH - MATRIX_WIDTH));
+	float targetY = constrain((float)cellY(activeCell) * 2 - MATRIX_HEIGHT / 2, 0.0f, (float)max(0, MAZE_PIXEL_HEIGHT - MATRIX_HEIGHT));
+
+	viewX += (targetX - viewX) * 0.05f;
+	viewY += (targetY - viewY) * 0.05f;
+
+	uint16_t offsetX = viewX + 0.5f;
+	uint16_t offsetY = viewY + 0.5f;
+
+	for (uint16_t y = 0; y < MATRIX_HEIGHT; y++) {
+		for (uint16_t x = 0; x < MATRIX_WIDTH; x++) {
+			uint16_t mazeX = x + offsetX;
+			uint16_t mazeY = y + offsetY;
+			CRGB colour = CRGB::Black;
+
+			if (mazeX < MAZE_PIXEL_WIDTH && mazeY < MAZE_PIXEL_HEIGHT) {
+				switch (mazePixels[mazeY][mazeX]) {
+					case MAZE_CARVED:
+						colour = paletteLookup(mazeHue[mazeY][mazeX]);
+						break;
+					case MAZE_SEARCHED:
+						colour = paletteLookup(mazeHue[mazeY][mazeX], 64);
+						break;
+					case MAZE_SOLUTION:
+						colour = CRGB::White;
+						break;
+					case MAZE_WALL:
+					default:
+						break;
+				}
+			}
+
+			leds[XY16(x, y)] = colour;
+		}
+	}
+
+	// Show where Wilson's random walk has got to
+	if (phase == MAZE_GENERATING && algorithm == MAZE_WILSON && walking && !carvingWalk) {
+		int x = cellX(activeCell) * 2 - offsetX;
+		int y = cellY(activeCell) * 2 - offsetY;
+
+		if (x >= 0 && x < MATRIX_WIDTH && y >= 0 && y < MATRIX_HEIGHT) {
+			leds[XY16(x, y)] = CRGB::White;
+		}
 	}
 }
 
@@ -216,11 +610,10 @@ void setup() {
 	// Allocate memory for the leds data structure, and set the FastLED palette
 	leds = (CRGB *)malloc(NUM_LEDS * sizeof(CRGB));
 	memset(leds, 0x00, NUM_LEDS * sizeof(CRGB));
-	currentPalette = RainbowColors_p;
+	setPalette(RainbowColors_p);
 	last_frame = millis();
 
-	cellCount = 0;
-	hue = 0;
+	startMaze();
 }
 
 ///////////////////
@@ -233,44 +626,15 @@ void loop() {
 		return;
 	}
 
-	if (1000 / default_fps + last_frame < millis()) {
-		if (cellCount < 1) {
-			// Reset the screen here
-			memset(leds, 0x00, NUM_LEDS * sizeof(CRGB));
-
-			// Reset the maze grid
-			for (int y = 0; y < height; y++) {
-				for (int x = 0; x < width; x++) {
-					grid[y][x] = None;
-				}
-			}
-
-			int x = random(width);
-			int y = random(height);
-
-			cells[0] = createPoint(x, y);
-
-			cellCount = 1;
-
-			hue = 0;
-			hueOffset = random(0, 256);
-		}
-
-		drawNextCell();
-
-		if (cellCount < 1) {
-			algorithm++;
+	unsigned long currentMillis = millis();
 
-			if (algorithm >= algorithmCount) {
-				algorithm = 0;
-			}
-
-			return;
-		}
+	if (1000 / default_fps + last_frame < currentMillis) {
+		advanceMaze(currentMillis - last_frame);
+		drawMaze();
 
 		updateScreen();
-		last_frame = millis();
+		last_frame = currentMillis;
 	}
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -56,7 +56,7 @@ void setup() {
 	// Allocate memory for the leds data structure, and set the FastLED palette
 	leds = (CRGB *)malloc(NUM_LEDS * sizeof(CRGB));
 	memset(leds, 0x00, NUM_LEDS * sizeof(CRGB));
-	currentPalette = RainbowColors_p;
+	setPalette(RainbowColors_p);
 	last_frame = millis();
 }
 
@@ -71,11 +71,11 @@ void loop() {
 	}
 
 	if (1000 / default_fps + last_frame < millis()) {
-		for (uint16_t x = 0; x < MATRIX_WIDTH; x++) {
-			for (uint16_t y = 0; y < MATRIX_HEIGHT; y++) {
-				leds[XY16(x, y)] = (x ^ y ^ flip) < count ? ColorFromPalette(currentPalette, ((x ^ y) << 2) + generation) : CRGB::Black;
+		parallelFor(MATRIX_HEIGHT, [](uint16_t y) {
+			for (uint16_t x = 0; x < MATRIX_WIDTH; x++) {
+				leds[XY16(x, y)] = (x ^ y ^ flip) < count ? paletteLookup(((x ^ y) << 2) + generation) : CRGB::Black;
 			}
-		}
+		});
 
 		count += dir;
 
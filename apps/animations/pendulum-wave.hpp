@@ -64,7 +64,7 @@ void setup() {
 	// Allocate memory for the leds data structure, and set the FastLED palette
 	leds = (CRGB *)malloc(NUM_LEDS * sizeof(CRGB));
 	memset(leds, 0x00, NUM_LEDS * sizeof(CRGB));
-	currentPalette = RainbowColors_p;
+	setPalette(RainbowColors_p);
 	last_frame = millis();
 }
 
@@ -88,7 +88,7 @@ void loop() {
 
 			uint8_t y = beatsin16(WAVE_BPM, 0, amp, x * beatsin16(SKEW_BPM, WAVE_TIMEMINSKEW, WAVE_TIMEMAXSKEW)) + offset;
 
-			leds[XY16(x, y)] = ColorFromPalette(currentPalette, x * 7);
+			leds[XY16(x, y)] = paletteLookup(x * 7);
 		}
 
 		updateScreen();
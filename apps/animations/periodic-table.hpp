@@ -31,6 +31,7 @@
 #include "../../lib/luxigrid.h"
 
 #include "../../lib/elements.hpp"
+#include "../../lib/marquee.hpp"
 
 int numElements = 118;
 
@@ -43,37 +44,37 @@ uint16_t green = dma_display->color565(0, 75, 0);
 // The time, in milliseconds, to display each element
 const int elementDelay = 3000;
 
+// Some of the longer names (e.g. Rutherfordium) don't fit across the panel, so they scroll
+Marquee elementNameMarquee(0, 22, 64, 5, 1);
+
 void displayElement(const Element& element) {
 	dma_display->clearScreen();
 
 	// Set the background colour based on the group (inspired by Wikipedia's colouring scheme)
-	dma_display->fillScreen(element.group == 's' ? red : element.group == 'p' ? yellow
-	                                                 : element.group == 'd'   ? blue
-	                                                                          : green);
+	uint16_t background = element.group == 's' ? red : element.group == 'p' ? yellow
+	                                              : element.group == 'd'   ? blue
+	                                                                       : green;
+
+	dma_display->fillScreen(background);
 
 	// Print the symbol
 	dma_display->setTextSize(2);
 	dma_display->setCursor(2, 9);
-	dma_display->print(element.symbol);
-
-	int16_t x1, y1;
-	uint16_t w, h;
+	printText(element.symbol);
 
 	// Print the atomic number
+	String number = String(element.number);
+
 	dma_display->setTextSize(1);
-	dma_display->getTextBounds(String(element.number), 0, 0, &x1, &y1, &w, &h);
-	dma_display->setCursor(64 - w - 2, 5);
-	dma_display->print(element.number);
+	dma_display->setCursor(64 - measureText(number) - 2, 5);
+	printText(number);
 
 	// Print the element's name
-	dma_display->getTextBounds(element.name, 0, 0, &x1, &y1, &w, &h);
-	dma_display->setCursor((64 - w) / 2, 22);
-	dma_display->print(element.name);
+	elementNameMarquee.setText(element.name, &Org_01, dma_display->color565(255, 255, 255), background);
 
 	// Print the atomic weight
-	dma_display->getTextBounds(element.atomicWeight, 0, 0, &x1, &y1, &w, &h);
-	dma_display->setCursor((64 - w) / 2, 29);
-	dma_display->print(element.atomicWeight);
+	dma_display->setCursor((64 - measureText(element.atomicWeight)) / 2, 29);
+	printText(element.atomicWeight);
 }
 
 ///////////////////
@@ -98,8 +99,13 @@ void loop() {
 	}
 
 	for (int i = 0; i < numElements; i++) {
+		// Don't draw over the OTA update box
+		if (otaUpdateInProgress) {
+			return;
+		}
+
 		displayElement(elements[i]);
-		delay(elementDelay);
+		delayWithMarquees(elementDelay);
 	}
 }
 
@@ -47,6 +47,107 @@
 int counter = 0;
 int cycles = 0;
 
+// The plasma is a sum of sine waves, so almost everything can be worked out ahead of time:
+// - A full sine table, built once, replaces sin16() for the terms that vary per pixel
+// - The terms that only depend on x or y are worked out once per column/row per frame
+// - Colours come straight from the palette cache, so there's no blending per pixel
+// Each pixel then costs a couple of table lookups and additions
+enum PlasmaFormula {
+	PLASMA_CLASSIC,   // Waves along x and y, plus a sine of x * y
+	PLASMA_RINGS,     // Rings spreading out from the centre, plus waves along x
+	PLASMA_DIAGONAL,  // Waves along x and y, plus a wave running diagonally
+	PLASMA_FORMULAS
+};
+
+// Move on to the next formula every time the cycle resets
+PlasmaFormula plasmaFormula = PLASMA_CLASSIC;
+
+// One full turn, with the same input and output range as sin16()
+#define PLASMA_SINE_BITS 10
+int16_t plasmaSine[1 << PLASMA_SINE_BITS];
+
+int16_t columnWave[MATRIX_WIDTH];
+int16_t rowWave[MATRIX_HEIGHT];
+
+// Each pixel's distance from the centre, as an angle for plasmaSin()
+uint16_t plasmaRadius[MATRIX_HEIGHT][MATRIX_WIDTH];
+
+inline int16_t plasmaSin(uint16_t angle) {
+	return plasmaSine[angle >> (16 - PLASMA_SINE_BITS)];
+}
+
+void setupPlasma() {
+	for (int i = 0; i < (1 << PLASMA_SINE_BITS); i++) {
+		plasmaSine[i] = sin16(i << (16 - PLASMA_SINE_BITS));
+	}
+
+	for (int y = 0; y < MATRIX_HEIGHT; y++) {
+		for (int x = 0; x < MATRIX_WIDTH; x++) {
+			float dx = x - MATRIX_CENTER_X + 0.5f;
+			float dy = y - MATRIX_CENTER_Y + 0.5f;
+
+			// The corners are far enough out to go past 65535, so wrap round explicitly (converting an out-of-range float straight to uint16_t is undefined)
+			plasmaRadius[y][x] = (uint16_t)(uint32_t)(sqrtf(dx * dx + dy * dy) * 2048);
+		}
+	}
+}
+
+// Work out the terms that only depend on x or y for this frame
+void fillPlasmaWaves(uint8_t wibble) {
+	for (int x = 0; x < MATRIX_WIDTH; x++) {
+		columnWave[x] = sin16(x * wibble * 2 + counter);
+	}
+
+	for (int y = 0; y < MATRIX_HEIGHT; y++) {
+		rowWave[y] = cos16(y * (128 - wibble) * 2 + counter);
+	}
+}
+
+void drawPlasmaRow(uint16_t y, uint8_t xyStep) {
+	CRGB *row = &leds[XY16(0, y)];
+
+	switch (plasmaFormula) {
+		case PLASMA_CLASSIC: {
+			// Stepping through y * x * xyStep / 2 one x at a time
+			uint32_t xy = 0;
+
+			for (int x = 0; x < MATRIX_WIDTH; x++) {
+				int16_t v = columnWave[x] + rowWave[y] + plasmaSin(xy / 2);
+				row[x] = paletteLookup((v >> 8) + 127);
+				xy += y * xyStep;
+			}
+
+			break;
+		}
+
+		case PLASMA_RINGS: {
+			uint16_t phase = counter * 512;
+
+			for (int x = 0; x < MATRIX_WIDTH; x++) {
+				int16_t v = columnWave[x] + plasmaSin(plasmaRadius[y][x] - phase);
+				row[x] = paletteLookup((v >> 8) + 127);
+			}
+
+			break;
+		}
+
+		case PLASMA_DIAGONAL: {
+			uint16_t diagonal = y * 1024 + counter * 256;
+
+			for (int x = 0; x < MATRIX_WIDTH; x++) {
+				int16_t v = columnWave[x] + rowWave[y] + plasmaSin(diagonal);
+				row[x] = paletteLookup((v >> 8) + 127);
+				diagonal += 1024;
+			}
+
+			break;
+		}
+
+		default:
+			break;
+	}
+}
+
 ///////////////////
 // SETUP FUNCTION
 ///////////////////
@@ -56,8 +157,10 @@ void setup() {
 	// Allocate memory for the leds data structure, and set the FastLED palette
 	leds = (CRGB *)malloc(NUM_LEDS * sizeof(CRGB));
 	memset(leds, 0x00, NUM_LEDS * sizeof(CRGB));
-	currentPalette = RainbowColors_p;
+	setPalette(RainbowColors_p);
 	last_frame = millis();
+
+	setupPlasma();
 }
 
 ///////////////////
@@ -71,18 +174,13 @@ void loop() {
 	}
 
 	if (1000 / default_fps + last_frame < millis()) {
-		for (int x = 0; x < MATRIX_WIDTH; x++) {
-			for (int y = 0; y < MATRIX_HEIGHT; y++) {
-				int16_t v = 0;
-				uint8_t wibble = sin8(counter);
+		uint8_t xyStep = cos8(-counter);
 
-				v += sin16(x * wibble * 2 + counter);
-				v += cos16(y * (128 - wibble) * 2 + counter);
-				v += sin16(y * x * cos8(-counter) / 2);
+		fillPlasmaWaves(sin8(counter));
 
-				leds[XY16(x, y)] = ColorFromPalette(currentPalette, (v >> 8) + 127);
-			}
-		}
+		parallelFor(MATRIX_HEIGHT, [=](uint16_t y) {
+			drawPlasmaRow(y, xyStep);
+		});
 
 		counter += 1;
 		cycles++;
@@ -90,6 +188,7 @@ void loop() {
 		if (cycles >= 2048) {
 			counter = 0;
 			cycles = 0;
+			plasmaFormula = (PlasmaFormula)((plasmaFormula + 1) % PLASMA_FORMULAS);
 		}
 
 		updateScreen();
@@ -40,44 +40,95 @@ struct Colour {
 	uint8_t b;
 };
 
+#define PONG_WARS_MAX_TEAMS 8
+#define PONG_WARS_MAX_BALLS_PER_TEAM 4
+#define PONG_WARS_MAX_SQUARE_SIZE 8
+
 struct PongWarsConfig {
-	Colour colour1;
-	Colour colour2;
+	uint8_t numberOfTeams = 2;
+	Colour teamColours[PONG_WARS_MAX_TEAMS] = {{237, 223, 214}, {200, 100, 81}, {72, 135, 196}, {242, 187, 58}, {98, 171, 96}, {156, 89, 182}, {230, 126, 34}, {52, 73, 94}};
+	uint8_t ballsPerTeam = 1;
+	uint8_t squareSize = 2;
 };
 
 PongWarsConfig pongWarsConfig;
 const char *pongWarsConfigFilename = "/config/apps/pong_wars.json";
 
-bool importPongWarsConfig(const JsonDocument &jsonDoc) {
-	if (!jsonDoc["colour1"].is<JsonObjectConst>() || !jsonDoc["colour2"].is<JsonObjectConst>()) {
+bool importColour(JsonVariantConst jsonColour, Colour &colour) {
+	if (!jsonColour["r"].is<uint8_t>() || !jsonColour["g"].is<uint8_t>() || !jsonColour["b"].is<uint8_t>()) {
 		return false;
 	}
 
-	JsonObjectConst colour1 = jsonDoc["colour1"].as<JsonObjectConst>();
-	JsonObjectConst colour2 = jsonDoc["colour2"].as<JsonObjectConst>();
+	colour.r = jsonColour["r"].as<uint8_t>();
+	colour.g = jsonColour["g"].as<uint8_t>();
+	colour.b = jsonColour["b"].as<uint8_t>();
 
-	// Return false if the colour1 format is invalid
-	if (!colour1["r"].is<uint8_t>() || !colour1["g"].is<uint8_t>() || !colour1["b"].is<uint8_t>()) {
-		return false;
-	}
+	return true;
+}
 
-	// Return false if the colour2 format is invalid
-	if (!colour2["r"].is<uint8_t>() || !colour2["g"].is<uint8_t>() || !colour2["b"].is<uint8_t>()) {
-		return false;
+void exportColour(JsonObject jsonColour, const Colour &colour) {
+	jsonColour["r"] = colour.r;
+	jsonColour["g"] = colour.g;
+	jsonColour["b"] = colour.b;
+}
+
+bool importPongWarsConfig(const JsonDocument &jsonDoc) {
+	PongWarsConfig config;
+
+	if (jsonDoc["teams"].is<JsonArrayConst>()) {
+		JsonArrayConst teams = jsonDoc["teams"].as<JsonArrayConst>();
+
+		// Return false if there are too few or too many teams
+		if (teams.size() < 2 || teams.size() > PONG_WARS_MAX_TEAMS) {
+			return false;
+		}
+
+		// Return false if any of the colours are invalid
+		config.numberOfTeams = 0;
+
+		for (JsonVariantConst team : teams) {
+			if (!importColour(team, config.teamColours[config.numberOfTeams++])) {
+				return false;
+			}
+		}
+
+		// Return false if the number of balls or the square size is invalid
+		if (!jsonDoc["ballsPerTeam"].is<uint8_t>() || !jsonDoc["squareSize"].is<uint8_t>()) {
+			return false;
+		}
+
+		config.ballsPerTeam = jsonDoc["ballsPerTeam"].as<uint8_t>();
+		config.squareSize = jsonDoc["squareSize"].as<uint8_t>();
+
+		if (config.ballsPerTeam < 1 || config.ballsPerTeam > PONG_WARS_MAX_BALLS_PER_TEAM || config.squareSize < 1 || config.squareSize > PONG_WARS_MAX_SQUARE_SIZE) {
+			return false;
+		}
+	} else {
+		// Older config files just have two colours
+		config.numberOfTeams = 2;
+
+		if (!importColour(jsonDoc["colour1"], config.teamColours[0]) || !importColour(jsonDoc["colour2"], config.teamColours[1])) {
+			return false;
+		}
 	}
 
 	// Otherwise, load the config into pongWarsConfig
-	pongWarsConfig.colour1.r = colour1["r"].as<uint8_t>();
-	pongWarsConfig.colour1.g = colour1["g"].as<uint8_t>();
-	pongWarsConfig.colour1.b = colour1["b"].as<uint8_t>();
-
-	pongWarsConfig.colour2.r = colour2["r"].as<uint8_t>();
-	pongWarsConfig.colour2.g = colour2["g"].as<uint8_t>();
-	pongWarsConfig.colour2.b = colour2["b"].as<uint8_t>();
+	pongWarsConfig = config;
 
 	return true;
 }
 
+void exportPongWarsConfig(JsonObject jsonConfig) {
+	JsonArray teams = jsonConfig["teams"].to<JsonArray>();
+
+	for (uint8_t i = 0; i < pongWarsConfig.numberOfTeams; i++) {
+		exportColour(teams.add<JsonObject>(), pongWarsConfig.teamColours[i]);
+	}
+
+	jsonConfig["ballsPerTeam"] = pongWarsConfig.ballsPerTeam;
+	jsonConfig["squareSize"] = pongWarsConfig.squareSize;
+}
+
 void loadPongWarsConfig() {
 	File pongWarsConfigFile = SD.open(pongWarsConfigFilename, FILE_READ);
 
@@ -86,15 +137,7 @@ void loadPongWarsConfig() {
 
 	// Set default pong wars config, and create new config file if none exists
 	if (!pongWarsConfigFile) {
-		JsonObject colour1 = jsonDoc["colour1"].to<JsonObject>();
-		colour1["r"] = 237;
-		colour1["g"] = 223;
-		colour1["b"] = 214;
-
-		JsonObject colour2 = jsonDoc["colour2"].to<JsonObject>();
-		colour2["r"] = 200;
-		colour2["g"] = 100;
-		colour2["b"] = 81;
+		exportPongWarsConfig(jsonDoc.to<JsonObject>());
 
 		jsonDoc.shrinkToFit();
 
@@ -161,28 +204,21 @@ void loadPongWarsConfig() {
 ///////////////////
 void retrieveAppConfig(JsonDocument &jsonDoc) {
 	// Pong Wars Config
-	JsonObject colour1 = jsonDoc["pong-wars"]["colour1"].to<JsonObject>();
-	colour1["r"] = pongWarsConfig.colour1.r;
-	colour1["g"] = pongWarsConfig.colour1.g;
-	colour1["b"] = pongWarsConfig.colour1.b;
-	JsonObject colour2 = jsonDoc["pong-wars"]["colour2"].to<JsonObject>();
-	colour2["r"] = pongWarsConfig.colour2.r;
-	colour2["g"] = pongWarsConfig.colour2.g;
-	colour2["b"] = pongWarsConfig.colour2.b;
+	exportPongWarsConfig(jsonDoc["pong-wars"].to<JsonObject>());
 }
 
 ///////////////////
 // VALIDATE APP CONFIG
 ///////////////////
 void validateAppConfig(AsyncWebServerRequest *request, bool &shouldSaveConfig) {
-	if (request->hasParam("colours", true)) {
-		const AsyncWebParameter *colours = request->getParam("colours", true);
+	if (request->hasParam("pongWars", true)) {
+		const AsyncWebParameter *pongWars = request->getParam("pongWars", true);
 
 		JsonDocument jsonDoc;
-		DeserializationError deserializationError = deserializeJson(jsonDoc, colours->value());
+		DeserializationError deserializationError = deserializeJson(jsonDoc, pongWars->value());
 
 		if (deserializationError || !importPongWarsConfig(jsonDoc)) {
-			request->send(400, "text/plain", "Pong Wars colour configuration is invalid");
+			request->send(400, "text/plain", "Pong Wars configuration is invalid");
 			shouldRestart = true;
 			return;
 		}
@@ -198,14 +234,7 @@ void saveAppConfig() {
 	File pongWarsConfigFile = SD.open(pongWarsConfigFilename, FILE_WRITE, true);
 
 	JsonDocument jsonDoc;
-	JsonObject colour1 = jsonDoc["colour1"].to<JsonObject>();
-	colour1["r"] = pongWarsConfig.colour1.r;
-	colour1["g"] = pongWarsConfig.colour1.g;
-	colour1["b"] = pongWarsConfig.colour1.b;
-	JsonObject colour2 = jsonDoc["colour2"].to<JsonObject>();
-	colour2["r"] = pongWarsConfig.colour2.r;
-	colour2["g"] = pongWarsConfig.colour2.g;
-	colour2["b"] = pongWarsConfig.colour2.b;
+	exportPongWarsConfig(jsonDoc.to<JsonObject>());
 
 	if (serializeJsonPretty(jsonDoc, pongWarsConfigFile) == 0) {
 		Serial.println("ERROR 2205 - Failed to Save Changes to App-Specific Config File");
@@ -216,28 +245,65 @@ void saveAppConfig() {
 }
 
 // 画像の幅と高さ、四角形のサイズ、四角形の数を定義 [Define square size and the number of squares to fill the screen with]
-int SQUARE_SIZE = 2;  // 16
-int numSquaresX = MATRIX_WIDTH / SQUARE_SIZE + 1;
-int numSquaresY = MATRIX_HEIGHT / SQUARE_SIZE + 1;
-
-// 四角形の位置情報を格納する2次元ベクトル [A 2D vector that stores the position information of a square]
-std::vector<std::vector<int>> squares;
-
-// ボールの情報を格納する構造体のベクトル [A vector of structs that store ball information]
-struct _pong {
-	double x;
-	double y;
-	double dx;
-	double dy;
-	int class_num;
+// The square size comes from the config, so the arrays are sized for the smallest squares allowed
+#define PONG_WARS_MAX_SQUARES ((MATRIX_WIDTH + 1) * (MATRIX_HEIGHT + 1))
+#define PONG_WARS_MAX_BALLS (PONG_WARS_MAX_TEAMS * PONG_WARS_MAX_BALLS_PER_TEAM)
+
+// The physics runs at a fixed rate, independent of how often the screen is redrawn
+// If the loop falls too far behind (e.g. after an OTA update was cancelled), the missed ticks are dropped rather than run all at once
+#define PONG_WARS_TICK 10
+#define PONG_WARS_MAX_TICKS_PER_FRAME 5
+#define PONG_WARS_FPS 60
+
+uint8_t squareSize;
+uint8_t numSquaresX;
+uint8_t numSquaresY;
+uint16_t numSquares;
+
+// 四角形の位置情報を格納する配列 [An array that stores which team each square belongs to], row by row
+uint8_t squares[PONG_WARS_MAX_SQUARES];
+
+// How many squares each team holds, kept up to date as squares change hands
+// A team with no squares left is out of the game, and once only one team is left, a new game starts
+uint16_t territory[PONG_WARS_MAX_TEAMS];
+uint8_t teamsRemaining;
+
+// Squares that need redrawing: ones that have changed team, and ones a ball was drawn over
+// squareChanged stops a square being added to the list twice
+uint16_t changedSquares[PONG_WARS_MAX_SQUARES];
+uint16_t changedSquareCount = 0;
+bool squareChanged[PONG_WARS_MAX_SQUARES];
+
+// ボールの情報を格納する構造体 [A struct that stores ball information]
+struct PongBall {
+	float x;
+	float y;
+	float dx;
+	float dy;
+	uint8_t team;
+
+	// Where the ball was last drawn, so the squares under it can be redrawn once it moves
+	int16_t drawnX;
+	int16_t drawnY;
+	bool drawn;
 };
 
-double vel = SQUARE_SIZE / 2;
+PongBall balls[PONG_WARS_MAX_BALLS];
+uint8_t numberOfBalls;
+
+float vel;
+float ballRadius;
 
-std::vector<_pong> pong;
+uint16_t teamColours[PONG_WARS_MAX_TEAMS];
 
-uint16_t color1;
-uint16_t color2;
+// randomNum() below only ever returns one of 100 values, so the bounce angles it leads to are worked out once in setup()
+#define PONG_BOUNCE_ANGLES 100
+float bounceCos[PONG_BOUNCE_ANGLES];
+float bounceSin[PONG_BOUNCE_ANGLES];
+
+unsigned long lastPhysicsTick = 0;
+unsigned long lastPongWarsFrame = 0;
+bool needsFullRedraw = true;
 
 // 乱数生成関数 [Random number generator function]
 double randomNum(double min, double max) {
@@ -247,57 +313,218 @@ double randomNum(double min, double max) {
 }
 
 // 数値の符号を返す関数 [This function returns the sign of a number]
-double sign(double A) {
+float sign(float A) {
 	return (A == 0) ? 0 : A / abs(A);
 }
 
-// 四角形とボールの衝突判定と反射を処理する関数 [This function handles collision detection and bouncing when balls hit squares]
-int updateSquareAndBounce(int numSquaresX, int numSquaresY, double x, double y, double &dx, double &dy, int class_num) {
-	double updatedDx = dx;
-	double updatedDy = dy;
-
-	// ボールの円周上の複数のポイントをチェックする [Check multiple points on the circumference of the ball]
-	for (double angle = 0; angle < M_PI * 2; angle += M_PI / 4) {
-		int checkX = x + cos(angle) * (SQUARE_SIZE / 2);
-		int checkY = y + sin(angle) * (SQUARE_SIZE / 2);
-
-		// チェックしたポイントが画面内かどうか確認 [Check if the point in question is within the screen]
-		int i = floor(checkX / SQUARE_SIZE);
-		int j = floor(checkY / SQUARE_SIZE);
-
-		if (i >= 0 && i < numSquaresX && j >= 0 && j < numSquaresY) {
-			if (squares[i][j] != class_num) {
-				squares[i][j] = class_num;
-
-				// 角度からバウンド方向を決定 [Determine the bounce direction from the angle]
-				if (abs(cos(angle)) > abs(sin(angle))) {
-					updatedDx = -updatedDx;
-				} else {
-					updatedDy = -updatedDy;
-				}
-			}
+void setupBounceAngles() {
+	// ボールがループにはまらないように、バウンドにノイズを加える [Add noise to bounces to keep the balls from getting stuck in loops]
+	for (int k = 0; k < PONG_BOUNCE_ANGLES; k++) {
+		double theta = M_PI / 4 * (1 + ((k / 100.0) * 1.1 - 0.1));
+
+		bounceCos[k] = cos(theta);
+		bounceSin[k] = sin(theta);
+	}
+}
+
+void markSquareChanged(uint16_t index) {
+	if (!squareChanged[index]) {
+		squareChanged[index] = true;
+		changedSquares[changedSquareCount++] = index;
+	}
+}
+
+// Mark every square under the ball's last drawn position, so it gets drawn over
+void markBallTrail(const PongBall &ball) {
+	if (!ball.drawn) {
+		return;
+	}
+
+	int radius = squareSize / 2;
+	int firstI = max(0, (ball.drawnX - radius) / squareSize), lastI = min(numSquaresX - 1, (ball.drawnX + radius) / squareSize);
+	int firstJ = max(0, (ball.drawnY - radius) / squareSize), lastJ = min(numSquaresY - 1, (ball.drawnY + radius) / squareSize);
+
+	for (int j = firstJ; j <= lastJ; j++) {
+		for (int i = firstI; i <= lastI; i++) {
+			markSquareChanged(j * numSquaresX + i);
 		}
 	}
+}
+
+// Hand a square over to the given team, keeping the territory counts up to date
+void captureSquare(uint16_t index, uint8_t team) {
+	uint8_t loser = squares[index];
+
+	territory[team]++;
+	territory[loser]--;
+
+	if (territory[loser] == 0) {
+		teamsRemaining--;
+	}
 
-	// ボールがループにはまらないように、バウンドにノイズを加える [Add noise to bounces to keep the balls from getting stuck in loops]
-	double theta = M_PI / 4 * (1 + randomNum(-0.1, 1));
-	dx = sign(updatedDx) * vel * cos(theta);
-	dy = sign(updatedDy) * vel * sin(theta);
+	squares[index] = team;
+	markSquareChanged(index);
+}
+
+// Capture the square at (x, y) if it belongs to another team; returns true if the ball should bounce off it
+bool hitSquare(float x, float y, uint8_t team) {
+	int i = x / squareSize;
+	int j = y / squareSize;
+
+	// チェックしたポイントが画面内かどうか確認 [Check if the point in question is within the screen]
+	if (i < 0 || i >= numSquaresX || j < 0 || j >= numSquaresY) {
+		return false;
+	}
+
+	uint16_t index = j * numSquaresX + i;
+
+	if (squares[index] == team) {
+		return false;
+	}
 
-	return 0;
+	captureSquare(index, team);
+	return true;
+}
+
+// 四角形とボールの衝突判定と反射を処理する関数 [This function handles collision detection and bouncing when balls hit squares]
+// Only the squares at the ball's leading edge can be hit, so that's one lookup per axis
+void updateSquareAndBounce(PongBall &ball) {
+	float updatedDx = ball.dx;
+	float updatedDy = ball.dy;
+
+	if (hitSquare(ball.x + sign(ball.dx) * ballRadius, ball.y, ball.team)) {
+		updatedDx = -updatedDx;
+	}
+
+	if (hitSquare(ball.x, ball.y + sign(ball.dy) * ballRadius, ball.team)) {
+		updatedDy = -updatedDy;
+	}
+
+	// ボールがループにはまらないように、バウンドにノイズを加える [Add noise to bounces to keep the balls from getting stuck in loops]
+	int k = rand() % PONG_BOUNCE_ANGLES;
+	ball.dx = sign(updatedDx) * vel * bounceCos[k];
+	ball.dy = sign(updatedDy) * vel * bounceSin[k];
 }
 
 // 画面の境界とボールの衝突を判定し、必要に応じて反射させる関数 [This function determines the collision of the ball with the screen boundary, bouncing if necessary]
-int checkBoundaryCollision(double x, double y, double &dx, double &dy) {
-	if (x + dx > MATRIX_WIDTH - SQUARE_SIZE / 2 || x + dx < SQUARE_SIZE / 2) {
-		dx = -dx;
+void checkBoundaryCollision(PongBall &ball) {
+	if (ball.x + ball.dx > MATRIX_WIDTH - ballRadius || ball.x + ball.dx < ballRadius) {
+		ball.dx = -ball.dx;
+	}
+
+	if (ball.y + ball.dy > MATRIX_HEIGHT - ballRadius || ball.y + ball.dy < ballRadius) {
+		ball.dy = -ball.dy;
+	}
+}
+
+// 画面をチームごとのエリアに分割し、それぞれのエリアにボールを配置 [Divide the screen into an area for each team, and place that team's balls in it]
+// Up to 4 teams get a column each; more than that are laid out in two rows
+void setupPongArena() {
+	uint8_t teams = pongWarsConfig.numberOfTeams;
+	uint8_t rows = teams <= 4 ? 1 : 2;
+	uint8_t cols = (teams + rows - 1) / rows;
+
+	memset(territory, 0, sizeof(territory));
+
+	for (int j = 0; j < numSquaresY; j++) {
+		for (int i = 0; i < numSquaresX; i++) {
+			uint8_t team = min(teams - 1, (j * rows / numSquaresY) * cols + i * cols / numSquaresX);
+
+			squares[j * numSquaresX + i] = team;
+			territory[team]++;
+		}
+	}
+
+	teamsRemaining = teams;
+
+	// ボールの初期位置と速度を設定 [Set the initial position and speeds of the balls], spread out down the middle of each team's area
+	uint8_t perTeam = pongWarsConfig.ballsPerTeam;
+	numberOfBalls = 0;
+
+	for (uint8_t team = 0; team < teams; team++) {
+		uint8_t row = team / cols;
+		uint8_t col = team % cols;
+		int i = (2 * col + 1) * numSquaresX / (2 * cols);
+
+		for (uint8_t k = 0; k < perTeam; k++) {
+			int j = (row * (perTeam + 1) + k + 1) * numSquaresY / (rows * (perTeam + 1));
+
+			PongBall &ball = balls[numberOfBalls++];
+			ball.x = constrain(i * squareSize + squareSize / 2.0f, ballRadius, MATRIX_WIDTH - ballRadius);
+			ball.y = constrain(j * squareSize + squareSize / 2.0f, ballRadius, MATRIX_HEIGHT - ballRadius);
+			ball.dx = (team + k) % 2 ? -vel : vel;
+			ball.dy = (team + k / 2) % 2 ? vel : -vel;
+			ball.team = team;
+			ball.drawn = false;
+		}
+	}
+
+	needsFullRedraw = true;
+}
+
+void stepPongWars() {
+	for (uint8_t b = 0; b < numberOfBalls; b++) {
+		PongBall &ball = balls[b];
+
+		// Teams that have lost all their squares are out
+		if (territory[ball.team] == 0) {
+			continue;
+		}
+
+		// 四角形との衝突判定と反射、境界との衝突判定 [collision detection and reflection with rectangles, collision detection with boundaries]
+		updateSquareAndBounce(ball);
+		checkBoundaryCollision(ball);
+
+		// ボールの位置を更新 [Update ball position]
+		ball.x += ball.dx;
+		ball.y += ball.dy;
+	}
+
+	if (teamsRemaining <= 1) {
+		setupPongArena();
+	}
+}
+
+void drawPongWars() {
+	if (needsFullRedraw) {
+		for (uint16_t index = 0; index < numSquares; index++) {
+			markSquareChanged(index);
+		}
+
+		needsFullRedraw = false;
+	}
+
+	for (uint8_t b = 0; b < numberOfBalls; b++) {
+		markBallTrail(balls[b]);
 	}
 
-	if (y + dy > MATRIX_HEIGHT - SQUARE_SIZE / 2 || y + dy < SQUARE_SIZE / 2) {
-		dy = -dy;
+	// 四角形の描画 [Draw the squares that have changed]
+	for (uint16_t k = 0; k < changedSquareCount; k++) {
+		uint16_t index = changedSquares[k];
+		int i = index % numSquaresX;
+		int j = index / numSquaresX;
+
+		dma_display->fillRect(i * squareSize, j * squareSize, squareSize, squareSize, teamColours[squares[index]]);
+		squareChanged[index] = false;
 	}
 
-	return 0;
+	changedSquareCount = 0;
+
+	// ボールの描画 [Draw the balls], each in the colour of the next team along
+	for (uint8_t b = 0; b < numberOfBalls; b++) {
+		PongBall &ball = balls[b];
+
+		if (territory[ball.team] == 0) {
+			ball.drawn = false;
+			continue;
+		}
+
+		ball.drawnX = ball.x;
+		ball.drawnY = ball.y;
+		ball.drawn = true;
+
+		dma_display->fillCircle(ball.drawnX, ball.drawnY, squareSize / 2, teamColours[(ball.team + 1) % pongWarsConfig.numberOfTeams]);
+	}
 }
 
 ///////////////////
@@ -310,41 +537,23 @@ void setup() {
 	// Indicate that the app-specific configuration has been loaded
 	configIsLoaded = true;
 
-	color1 = dma_display->color565(pongWarsConfig.colour1.r, pongWarsConfig.colour1.g, pongWarsConfig.colour1.b);
-	color2 = dma_display->color565(pongWarsConfig.colour2.r, pongWarsConfig.colour2.g, pongWarsConfig.colour2.b);
-
-	// 四角形の位置情報を初期化 [Initialize the position information of the squares]
-	squares.resize(numSquaresX);
-	for (int i = 0; i < numSquaresX; i++) {
-		squares[i].resize(numSquaresY);
+	for (uint8_t team = 0; team < pongWarsConfig.numberOfTeams; team++) {
+		const Colour &colour = pongWarsConfig.teamColours[team];
+		teamColours[team] = dma_display->color565(colour.r, colour.g, colour.b);
 	}
 
-	// 画面を4つのエリアに分割し、それぞれに異なるクラスの四角形を配置 [Divide the screen into areas, and place squares of different classes in each area]
-	int pong_no = 2;
-	pong.resize(pong_no);
+	squareSize = pongWarsConfig.squareSize;
+	numSquaresX = MATRIX_WIDTH / squareSize + 1;
+	numSquaresY = MATRIX_HEIGHT / squareSize + 1;
+	numSquares = numSquaresX * numSquaresY;
 
-	for (int i = 0; i < numSquaresX; i++) {
-		for (int j = 0; j < numSquaresY; j++) {
-			if (i <= (numSquaresX / 2)) {
-				squares[i][j] = 0;
-			} else {
-				squares[i][j] = 1;
-			}
-		}
-	}
+	vel = squareSize / 2.0f;
+	ballRadius = squareSize / 2.0f;
 
-	// ボールの初期位置と速度を設定 [Set the initial position and speeds of the balls]
-	pong[0].x = MATRIX_WIDTH / 4;
-	pong[0].y = MATRIX_HEIGHT / 4;
-	pong[0].dx = vel;
-	pong[0].dy = -vel;
-	pong[0].class_num = 0;
-
-	pong[1].x = MATRIX_WIDTH * 3 / 4;
-	pong[1].y = MATRIX_HEIGHT / 4;
-	pong[1].dx = -vel;
-	pong[1].dy = vel;
-	pong[1].class_num = 1;
+	setupBounceAngles();
+	setupPongArena();
+
+	lastPhysicsTick = millis();
 }
 
 ///////////////////
@@ -352,42 +561,32 @@ void setup() {
 ///////////////////
 void loop() {
 	// If an OTA update is in progress, skip this iteration of the loop
+	// The OTA screen draws over everything, so redraw the whole grid afterwards
 	if (otaUpdateInProgress) {
+		needsFullRedraw = true;
 		vTaskDelay(10 / portTICK_PERIOD_MS);
 		return;
 	}
 
-	// 四角形の描画 [Draw the squares]
-	for (int i = 0; i < squares.size(); i++) {
-		for (int j = 0; j < squares[i].size(); j++) {
-			// 各クラスに応じて四角形を描画 [Draw the squares of each class]
-			if (squares[i][j] == 0) {
-				dma_display->fillRect(i * SQUARE_SIZE, j * SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE, color1);
-			}
-			if (squares[i][j] == 1) {
-				dma_display->fillRect(i * SQUARE_SIZE, j * SQUARE_SIZE, SQUARE_SIZE, SQUARE_SIZE, color2);
-			}
-		}
-	}
-
-	// ボールの描画と更新 [Draw and update the balls]
-	for (int i = 0; i < pong.size(); i++) {
-		// 各クラスに応じてボールの色を設定 [Set the ball's color according to its class_num]
-		uint16_t color = pong[i].class_num == 0 ? color2 : color1;
+	unsigned long currentMillis = millis();
+	uint8_t ticks = 0;
 
-		// ボールを描画 [Draw the ball]
-		dma_display->fillCircle(pong[i].x, pong[i].y, SQUARE_SIZE / 2, color);
+	while (currentMillis - lastPhysicsTick >= PONG_WARS_TICK) {
+		if (ticks++ == PONG_WARS_MAX_TICKS_PER_FRAME) {
+			lastPhysicsTick = currentMillis;
+			break;
+		}
 
-		// 四角形との衝突判定と反射、境界との衝突判定 [collision detection and reflection with rectangles, collision detection with boundaries]
-		updateSquareAndBounce(numSquaresX, numSquaresY, pong[i].x, pong[i].y, pong[i].dx, pong[i].dy, pong[i].class_num);
-		checkBoundaryCollision(pong[i].x, pong[i].y, pong[i].dx, pong[i].dy);
+		stepPongWars();
+		lastPhysicsTick += PONG_WARS_TICK;
+	}
 
-		// ボールの位置を更新 [Update ball position]
-		pong[i].x += pong[i].dx;
-		pong[i].y += pong[i].dy;
+	if (currentMillis - lastPongWarsFrame >= 1000 / PONG_WARS_FPS) {
+		drawPongWars();
+		lastPongWarsFrame = currentMillis;
 	}
 
-	delay(10);
+	delay(1);
 }
 
 #endif
\ No newline at end of file
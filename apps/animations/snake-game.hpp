@@ -30,129 +30,232 @@
 #include "Arduino.h"
 #include "../../lib/luxigrid.h"
 
-struct Point {
-	int x;
-	int y;
-};
+#define SNAKE_CELLS (MATRIX_WIDTH * MATRIX_HEIGHT)
+
+// The snake moves faster as it grows, so the endgame doesn't take forever; each move is constant time, so this never holds up a frame
+#define SNAKE_FRAME_TIME 20
+#define SNAKE_GROWTH_PER_EXTRA_MOVE 256
+
+// How long to show a full board before starting again, in milliseconds
+#define SNAKE_WIN_HOLD_TIME 3000
 
+// Cells are numbered row by row; the board wraps around at the edges
 struct Snake {
-	Point head;
-	Point tail[2048];
-	int length;
-	int direction;
+	// The body is a ring buffer of cells, with body[head] being the head and the tail length - 1 cells behind it
+	uint16_t body[SNAKE_CELLS];
+	uint16_t head;
+	uint16_t length;
 };
 
-Point fruit;
 Snake snake;
+uint16_t fruit;
 
-// The fruit can be placed on any tile that doesn't intersect with the snake
-void placeFruit() {
-	bool valid = false;
-
-	while (!valid) {
-		fruit.x = random(0, MATRIX_WIDTH);
-		fruit.y = random(0, MATRIX_HEIGHT);
-		valid = true;
-
-		for (int i = 0; i < snake.length; i++) {
-			if (fruit.x == snake.tail[i].x && fruit.y == snake.tail[i].y) {
-				valid = false;
-				break;
-			}
+// One bit per cell, set where the snake is
+uint32_t occupied[(SNAKE_CELLS + 31) / 32];
+
+// Every cell the snake isn't on, so the fruit can be placed with one random pick
+// freePosition says where each free cell is in the list, so cells can be taken out of it in constant time
+uint16_t freeCells[SNAKE_CELLS];
+uint16_t freePosition[SNAKE_CELLS];
+uint16_t freeCount = 0;
+
+// The autopilot follows a Hamiltonian cycle through every cell, taking shortcuts while it's safe to
+// cycleIndex is each cell's position around the cycle, and cycleCell is the cell at each position
+uint16_t cycleIndex[SNAKE_CELLS];
+uint16_t cycleCell[SNAKE_CELLS];
+
+bool needsFullRedraw = true;
+bool gameWon = false;
+unsigned long gameWonTime = 0;
+unsigned long lastSnakeFrame = 0;
+
+uint16_t snakeColour;
+uint16_t fruitColour;
+
+bool isOccupied(uint16_t cell) {
+	return occupied[cell >> 5] & (1UL << (cell & 31));
+}
+
+void occupyCell(uint16_t cell) {
+	occupied[cell >> 5] |= 1UL << (cell & 31);
+
+	// Swap the last free cell into this one's place
+	uint16_t last = freeCells[--freeCount];
+	freeCells[freePosition[cell]] = last;
+	freePosition[last] = freePosition[cell];
+}
+
+void releaseCell(uint16_t cell) {
+	occupied[cell >> 5] &= ~(1UL << (cell & 31));
+
+	freePosition[cell] = freeCount;
+	freeCells[freeCount++] = cell;
+}
+
+uint16_t snakeTail() {
+	return snake.body[(snake.head + SNAKE_CELLS - snake.length + 1) % SNAKE_CELLS];
+}
+
+// How far ahead of a the cell b is, going around the cycle
+uint16_t cycleDistance(uint16_t a, uint16_t b) {
+	return (cycleIndex[b] + SNAKE_CELLS - cycleIndex[a]) % SNAKE_CELLS;
+}
+
+// Snake along the rows from the second column onwards, then come back up the first column
+// This needs an even number of rows, which every supported panel has
+void setupCycle() {
+	uint16_t position = 0;
+
+	for (uint16_t y = 0; y < MATRIX_HEIGHT; y++) {
+		for (uint16_t i = 1; i < MATRIX_WIDTH; i++) {
+			uint16_t x = y % 2 == 0 ? i : MATRIX_WIDTH - i;
+			cycleCell[position++] = y * MATRIX_WIDTH + x;
 		}
 	}
+
+	for (int16_t y = MATRIX_HEIGHT - 1; y >= 0; y--) {
+		cycleCell[position++] = y * MATRIX_WIDTH;
+	}
+
+	for (position = 0; position < SNAKE_CELLS; position++) {
+		cycleIndex[cycleCell[position]] = position;
+	}
+}
+
+// The fruit can be placed on any tile that doesn't intersect with the snake
+void placeFruit() {
+	fruit = freeCells[random(freeCount)];
 }
 
 void resetGame() {
-	// Randomly place the snake on the screen, and give it a random initial direction
-	snake.head = {random(0, MATRIX_WIDTH), random(0, MATRIX_HEIGHT)};
-	snake.length = 2;
-	snake.direction = random(0, 4);
+	memset(occupied, 0, sizeof(occupied));
 
-	// Place the first segment of the tail based on the initial direction
-	// It goes Down, Right, Up, Left
-	switch (snake.direction) {
-		case 0:
-			snake.tail[0] = {snake.head.x, (snake.head.y - 1 + MATRIX_HEIGHT) % MATRIX_HEIGHT};
-			break;
-		case 1:
-			snake.tail[0] = {(snake.head.x - 1 + MATRIX_WIDTH) % MATRIX_WIDTH, snake.head.y};
-			break;
-		case 2:
-			snake.tail[0] = {snake.head.x, (snake.head.y + 1) % MATRIX_HEIGHT};
-			break;
-		case 3:
-			snake.tail[0] = {(snake.head.x + 1) % MATRIX_WIDTH, snake.head.y};
-			break;
+	for (uint16_t cell = 0; cell < SNAKE_CELLS; cell++) {
+		freeCells[cell] = cell;
+		freePosition[cell] = cell;
 	}
 
-	// Initialize the second segment to be right behind the first segment
-	if (snake.length > 1) {
-		snake.tail[1] = snake.tail[0];
-	}
+	freeCount = SNAKE_CELLS;
+
+	// Randomly place a two-cell snake somewhere on the cycle
+	uint16_t position = random(0, SNAKE_CELLS);
+
+	snake.length = 2;
+	snake.head = 1;
+	snake.body[0] = cycleCell[position];
+	snake.body[1] = cycleCell[(position + 1) % SNAKE_CELLS];
+
+	occupyCell(snake.body[0]);
+	occupyCell(snake.body[1]);
 
 	placeFruit();
-}
 
-bool wouldBeCollision(Point p) {
-	for (int i = 0; i < snake.length; i++) {
-		if (p.x == snake.tail[i].x && p.y == snake.tail[i].y) {
-			return true;
-		}
-	}
-	return false;
+	gameWon = false;
+	needsFullRedraw = true;
 }
 
-void moveSnake() {
-	// Move the tail
-	for (int i = snake.length - 1; i > 0; i--) {
-		snake.tail[i] = snake.tail[i - 1];
-	}
+// Take the biggest shortcut along the cycle that can't trap the snake
+// The body always lies along the cycle in order, so any cell between the head and the tail (going around the cycle) is safe to jump to
+// Shortcuts get more cautious as the board fills, and stop altogether once it's half full
+uint16_t chooseNextCell() {
+	uint16_t head = snake.body[snake.head];
+	uint16_t x = head % MATRIX_WIDTH;
+	uint16_t y = head / MATRIX_WIDTH;
+
+	int distanceToFruit = cycleDistance(head, fruit);
+	int distanceToTail = cycleDistance(head, snakeTail());
+	int emptyCells = SNAKE_CELLS - snake.length;
+
+	int allowedShortcut = distanceToTail - 4;
+
+	if (emptyCells < SNAKE_CELLS / 2) {
+		allowedShortcut = 0;
+	} else if (distanceToFruit < distanceToTail) {
+		allowedShortcut -= 1;
 
-	if (snake.length > 1) {
-		snake.tail[0] = snake.head;
+		// Leave room for the tail to stay put while the snake grows
+		if ((distanceToTail - distanceToFruit) * 4 > emptyCells) {
+			allowedShortcut -= 10;
+		}
 	}
 
-	// Calculate potential next positions
-	Point potentialMoves[4];
-	potentialMoves[0] = {snake.head.x, (snake.head.y + 1) % MATRIX_HEIGHT};                  // Down
-	potentialMoves[1] = {(snake.head.x + 1) % MATRIX_WIDTH, snake.head.y};                   // Right
-	potentialMoves[2] = {snake.head.x, (snake.head.y - 1 + MATRIX_HEIGHT) % MATRIX_HEIGHT};  // Up
-	potentialMoves[3] = {(snake.head.x - 1 + MATRIX_WIDTH) % MATRIX_WIDTH, snake.head.y};    // Left
+	// Never jump past the fruit
+	allowedShortcut = min(allowedShortcut, distanceToFruit);
+
+	uint16_t neighbours[4] = {
+	    (uint16_t)(((y + 1) % MATRIX_HEIGHT) * MATRIX_WIDTH + x),                  // Down
+	    (uint16_t)(y * MATRIX_WIDTH + (x + 1) % MATRIX_WIDTH),                     // Right
+	    (uint16_t)(((y + MATRIX_HEIGHT - 1) % MATRIX_HEIGHT) * MATRIX_WIDTH + x),  // Up
+	    (uint16_t)(y * MATRIX_WIDTH + (x + MATRIX_WIDTH - 1) % MATRIX_WIDTH),      // Left
+	};
 
-	// Determine the best move based on the distance to fruit and the likelihood of avoiding collisions
-	int bestMove = -1;
-	int shortestDistance = MATRIX_WIDTH * MATRIX_HEIGHT;
+	// Otherwise just follow the cycle
+	uint16_t best = cycleCell[(cycleIndex[head] + 1) % SNAKE_CELLS];
+	int bestDistance = 1;
 
-	for (int i = 0; i < 4; i++) {
-		if (!wouldBeCollision(potentialMoves[i])) {
-			int distance = abs(potentialMoves[i].x - fruit.x) + abs(potentialMoves[i].y - fruit.y);
+	for (uint16_t next : neighbours) {
+		int distance = cycleDistance(head, next);
 
-			if (distance < shortestDistance) {
-				shortestDistance = distance;
-				bestMove = i;
-			}
+		if (distance > bestDistance && distance <= allowedShortcut && !isOccupied(next)) {
+			best = next;
+			bestDistance = distance;
 		}
 	}
 
-	// Move the snake's head based on the best move
-	if (bestMove != -1) {
-		snake.head = potentialMoves[bestMove];
-		snake.direction = bestMove;
-	} else {
-		// Reset the game if no valid move is found (i.e., the snake has collided with itself)
-		// The snake is fairly "smart", but it's bound to run into itself eventually
-		// Of course, that makes for an entertaining animation
+	return best;
+}
+
+// Moves the snake one cell, redrawing just the cells that changed; returns false if the snake has filled the board
+bool moveSnake() {
+	uint16_t next = chooseNextCell();
+	bool eating = next == fruit;
+
+	// The tail moves out of the way first, unless the snake is growing
+	if (!eating) {
+		uint16_t tail = snakeTail();
+		releaseCell(tail);
+		dma_display->drawPixel(tail % MATRIX_WIDTH, tail / MATRIX_WIDTH, 0);
+	}
+
+	// The autopilot should never get here, but start again rather than run over itself if it does
+	if (isOccupied(next)) {
 		resetGame();
-		return;
+		return true;
 	}
 
+	snake.head = (snake.head + 1) % SNAKE_CELLS;
+	snake.body[snake.head] = next;
+	occupyCell(next);
+	dma_display->drawPixel(next % MATRIX_WIDTH, next / MATRIX_WIDTH, snakeColour);
+
 	// Handle what happens when the snake eats the fruit
-	if (snake.head.x == fruit.x && snake.head.y == fruit.y) {
+	if (eating) {
 		snake.length++;
-		snake.tail[snake.length - 1] = snake.tail[snake.length - 2];
+
+		if (freeCount == 0) {
+			return false;
+		}
+
 		placeFruit();
+		dma_display->drawPixel(fruit % MATRIX_WIDTH, fruit / MATRIX_WIDTH, fruitColour);
 	}
+
+	return true;
+}
+
+void drawSnakeGame() {
+	dma_display->clearScreen();
+
+	for (uint16_t i = 0; i < snake.length; i++) {
+		uint16_t cell = snake.body[(snake.head + SNAKE_CELLS - i) % SNAKE_CELLS];
+		dma_display->drawPixel(cell % MATRIX_WIDTH, cell / MATRIX_WIDTH, snakeColour);
+	}
+
+	if (!gameWon) {
+		dma_display->drawPixel(fruit % MATRIX_WIDTH, fruit / MATRIX_WIDTH, fruitColour);
+	}
+
+	needsFullRedraw = false;
 }
 
 ///////////////////
@@ -160,6 +263,11 @@ void moveSnake() {
 ///////////////////
 void setup() {
 	setupMatrix();
+
+	snakeColour = dma_display->color565(0, 255, 0);
+	fruitColour = dma_display->color565(255, 0, 0);
+
+	setupCycle();
 	resetGame();
 }
 
@@ -168,24 +276,41 @@ void setup() {
 ///////////////////
 void loop() {
 	// If an OTA update is in progress, skip this iteration of the loop
+	// The OTA screen draws over everything, so redraw the whole board afterwards
 	if (otaUpdateInProgress) {
+		needsFullRedraw = true;
 		vTaskDelay(10 / portTICK_PERIOD_MS);
 		return;
 	}
 
-	moveSnake();
-	dma_display->clearScreen();
+	if (millis() - lastSnakeFrame < SNAKE_FRAME_TIME) {
+		delay(1);
+		return;
+	}
+
+	lastSnakeFrame = millis();
+
+	if (needsFullRedraw) {
+		drawSnakeGame();
+	}
+
+	if (gameWon) {
+		if (millis() - gameWonTime >= SNAKE_WIN_HOLD_TIME) {
+			resetGame();
+		}
 
-	// Draw snake
-	for (int i = 0; i < snake.length; i++) {
-		dma_display->drawPixel(snake.tail[i].x, snake.tail[i].y, dma_display->color565(0, 255, 0));
+		return;
 	}
 
-	dma_display->drawPixel(snake.head.x, snake.head.y, dma_display->color565(0, 255, 0));
+	uint8_t moves = 1 + snake.length / SNAKE_GROWTH_PER_EXTRA_MOVE;
 
-	// Draw fruit
-	dma_display->drawPixel(fruit.x, fruit.y, dma_display->color565(255, 0, 0));
-	delay(20);
+	for (uint8_t i = 0; i < moves; i++) {
+		if (!moveSnake()) {
+			gameWon = true;
+			gameWonTime = millis();
+			break;
+		}
+	}
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -36,8 +36,18 @@
 
 #include "../../lib/animation-helpers.hpp"
 
-static const byte SNAKE_LENGTH = 16;
-CRGB colors[SNAKE_LENGTH];
+// The snakes share one pool of segments, so there can be lots of short snakes or a few long ones
+#define MAX_SNAKES 16
+#define SNAKE_SEGMENT_POOL 512
+
+// How bright the last segment of a trail is, relative to the head
+#define SNAKE_TAIL_BRIGHTNESS 0.4f
+
+uint8_t snakeCount = 8;
+uint16_t snakeLength = 16;
+
+// Every pixel on the screen is scaled by this once per frame, which fades each trail down to SNAKE_TAIL_BRIGHTNESS by its last segment
+uint8_t snakeFade;
 uint8_t initialHue;
 
 enum Direction {
@@ -52,8 +62,16 @@ struct Pixel {
 	uint8_t y;
 };
 
+Pixel snakeSegments[SNAKE_SEGMENT_POOL];
+
+// How many segments (of any snake) are on each pixel, so a tail only clears a pixel once nothing else is on it
+// The snakes cross each other and all start stacked in the corner, so clearing unconditionally would punch holes in the other trails
+uint16_t segmentsAt[MATRIX_WIDTH * MATRIX_HEIGHT];
+
 struct Snake {
-	Pixel pixels[SNAKE_LENGTH];
+	// A ring buffer of snakeLength segments, with pixels[head] being the head
+	Pixel *pixels;
+	uint16_t head;
 	Direction direction;
 
 	void newDirection() {
@@ -70,52 +88,72 @@ struct Snake {
 		}
 	}
 
-	void shuffleDown() {
-		for (byte i = SNAKE_LENGTH - 1; i > 0; i--) {
-			pixels[i] = pixels[i - 1];
-		}
-	}
-
-	void reset() {
+	void reset(Pixel *segments) {
+		pixels = segments;
+		head = 0;
 		direction = UP;
 
-		for (int i = 0; i < SNAKE_LENGTH; i++) {
+		for (uint16_t i = 0; i < snakeLength; i++) {
 			pixels[i].x = 0;
 			pixels[i].y = 0;
 		}
+
+		segmentsAt[0] += snakeLength;
 	}
 
+	// Moves the head on by one, reusing the slot of the segment that just dropped off the end of the tail
 	void move() {
+		Pixel next = pixels[head];
+
 		switch (direction) {
 			case UP:
-				pixels[0].y = (pixels[0].y + 1) % MATRIX_HEIGHT;
+				next.y = (next.y + 1) % MATRIX_HEIGHT;
 				break;
 			case LEFT:
-				pixels[0].x = (pixels[0].x + 1) % MATRIX_WIDTH;
+				next.x = (next.x + 1) % MATRIX_WIDTH;
 				break;
 			case DOWN:
-				pixels[0].y = pixels[0].y == 0 ? MATRIX_HEIGHT - 1 : pixels[0].y - 1;
+				next.y = next.y == 0 ? MATRIX_HEIGHT - 1 : next.y - 1;
 				break;
 			case RIGHT:
-				pixels[0].x = pixels[0].x == 0 ? MATRIX_WIDTH - 1 : pixels[0].x - 1;
+				next.x = next.x == 0 ? MATRIX_WIDTH - 1 : next.x - 1;
 				break;
 		}
-	}
 
-	void draw(CRGB colors[SNAKE_LENGTH]) {
-		for (byte i = 0; i < SNAKE_LENGTH; i++) {
-			// Original
-			// leds[XY16(pixels[i].x, pixels[i].y)] = colors[i] %= (255 - i * (255 / SNAKE_LENGTH));
-			// Longer Trails
-			// leds[XY16(pixels[i].x, pixels[i].y)] = colors[i] %= (255 - i * (255 / SNAKE_LENGTH / 1.5));
-			// Compromise
-			leds[XY16(pixels[i].x, pixels[i].y)] = colors[i] %= (255 - i * (10));
+		head = head + 1 == snakeLength ? 0 : head + 1;
+
+		// Cut the trail off cleanly where the old tail was, unless another segment is still there
+		Pixel tail = pixels[head];
+
+		if (--segmentsAt[tail.y * MATRIX_WIDTH + tail.x] == 0) {
+			leds[XY16(tail.x, tail.y)] = CRGB::Black;
 		}
+
+		pixels[head] = next;
+		segmentsAt[next.y * MATRIX_WIDTH + next.x]++;
+	}
+
+	// Only the head is drawn; the fade pass turns the earlier heads into the trail
+	void draw(const CRGB &colour) {
+		leds[XY16(pixels[head].x, pixels[head].y)] = colour;
 	}
 };
 
-static const int snakeCount = 8;
-Snake snakes[snakeCount];
+Snake snakes[MAX_SNAKES];
+
+// Can be called at any time to change the number of snakes and their length; the snakes start again from the corner
+void setupSnakes(uint8_t count, uint16_t length) {
+	snakeCount = constrain(count, 1, MAX_SNAKES);
+	snakeLength = constrain(length, 2, SNAKE_SEGMENT_POOL / snakeCount);
+	snakeFade = 255 * powf(SNAKE_TAIL_BRIGHTNESS, 1.0f / (snakeLength - 1));
+
+	memset(leds, 0x00, NUM_LEDS * sizeof(CRGB));
+	memset(segmentsAt, 0, sizeof(segmentsAt));
+
+	for (uint8_t i = 0; i < snakeCount; i++) {
+		snakes[i].reset(&snakeSegments[i * snakeLength]);
+	}
+}
 
 ///////////////////
 // SETUP FUNCTION
@@ -126,13 +164,10 @@ void setup() {
 	// Allocate memory for the leds data structure, and set the FastLED palette
 	leds = (CRGB *)malloc(NUM_LEDS * sizeof(CRGB));
 	memset(leds, 0x00, NUM_LEDS * sizeof(CRGB));
-	currentPalette = RainbowColors_p;
+	setPalette(RainbowColors_p);
 	last_frame = millis();
 
-	for (int i = 0; i < snakeCount; i++) {
-		Snake *snake = &snakes[i];
-		snake->reset();
-	}
+	setupSnakes(snakeCount, snakeLength);
 }
 
 ///////////////////
@@ -146,18 +181,19 @@ void loop() {
 	}
 
 	if (1000 / default_fps + last_frame < millis()) {
-		fill_palette(colors, SNAKE_LENGTH, initialHue++, 5, currentPalette, 255, LINEARBLEND);
+		nscale8(leds, NUM_LEDS, snakeFade);
+
+		CRGB colour = paletteLookup(initialHue++);
 
-		for (int i = 0; i < snakeCount; i++) {
+		for (uint8_t i = 0; i < snakeCount; i++) {
 			Snake *snake = &snakes[i];
-			snake->shuffleDown();
 
 			if (random(10) > 8) {
 				snake->newDirection();
 			}
 
 			snake->move();
-			snake->draw(colors);
+			snake->draw(colour);
 		}
 
 		updateScreen();
@@ -52,7 +52,7 @@ void setup() {
 	// Allocate memory for the leds data structure, and set the FastLED palette
 	leds = (CRGB *)malloc(NUM_LEDS * sizeof(CRGB));
 	memset(leds, 0x00, NUM_LEDS * sizeof(CRGB));
-	currentPalette = RainbowColors_p;
+	setPalette(RainbowColors_p);
 	last_frame = millis();
 }
 
@@ -78,10 +78,10 @@ void loop() {
 
 		// The colour of each point shifts over time, each at a different speed.
 		uint16_t ms = millis();
-		leds[XY16(i, j)] += ColorFromPalette(currentPalette, ms / 11);
-		leds[XY16(ni, nj)] += ColorFromPalette(currentPalette, ms / 17);
-		leds[XY16(i, nj)] += ColorFromPalette(currentPalette, ms / 37);
-		leds[XY16(ni, j)] += ColorFromPalette(currentPalette, ms / 41);
+		leds[XY16(i, j)] += paletteLookup(ms / 11);
+		leds[XY16(ni, nj)] += paletteLookup(ms / 17);
+		leds[XY16(i, nj)] += paletteLookup(ms / 37);
+		leds[XY16(ni, j)] += paletteLookup(ms / 41);
 
 		updateScreen();
 		last_frame = millis();
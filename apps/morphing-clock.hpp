@@ -212,83 +212,23 @@ Digit digit3;
 Digit digit4;
 Digit digit5;
 
+Digit *digits[] = {&digit0, &digit1, &digit2, &digit3, &digit4, &digit5};
+
 TimeInfo pNow;
 uint8_t pHH, pMM, pSS;
 
-bool timestampsAreEqual(TimeInfo a, TimeInfo b) {
-	return a.second == b.second && a.minute == b.minute && a.hour == b.hour;
-}
-
-///////////////////
-// SETUP FUNCTION
-///////////////////
-void setup() {
-	setupMatrix();
-	loadMorphingClockConfig();
-
-	// Indicate that the app-specific configuration has been loaded
-	configIsLoaded = true;
-
-	clockfaceColour = dma_display->color565(morphingClockConfig.r, morphingClockConfig.g, morphingClockConfig.b);
-	digit0.init(0, 63 - 1 - 9 * 1, 9, clockfaceColour);
-	digit1.init(0, 63 - 1 - 9 * 2, 9, clockfaceColour);
-	digit2.init(0, 63 - 4 - 9 * 3, 9, clockfaceColour);
-	digit3.init(0, 63 - 4 - 9 * 4, 9, clockfaceColour);
-	digit4.init(0, 63 - 7 - 9 * 5, 9, clockfaceColour);
-	digit5.init(0, 63 - 7 - 9 * 6, 9, clockfaceColour);
-
-	DateTime rtcTime = rtc.now();
-	time_t utcTimestamp = rtcTime.unixtime();
-
-	struct tm tmNow;
-	localtime_r(&utcTimestamp, &tmNow);
-
-	TimeInfo now = getTimeInfo(tmNow);
-
-	int ss = now.second;
-	int mm = now.minute;
-	int hh = now.hour;
-
-	if (!globalConfig.is24h) {
-		if (hh > 12) {
-			hh -= 12;
-		}
-
-		// Convert 00:xx to 12:xx AM
-		if (hh == 0) {
-			hh = 12;
-		}
-	}
+// How often to check the RTC for a new time, in milliseconds
+#define CLOCK_CHECK_INTERVAL 150
 
-	int s0 = ss % 10;
-	int s1 = ss / 10;
-	int m0 = mm % 10;
-	int m1 = mm / 10;
-	int h0 = hh % 10;
-	int h1 = hh / 10;
-
-	digit1.DrawColon(clockfaceColour);
-	digit3.DrawColon(clockfaceColour);
-	digit0.Draw(s0, clockfaceColour);
-	digit1.Draw(s1, clockfaceColour);
-	digit2.Draw(m0, clockfaceColour);
-	digit3.Draw(m1, clockfaceColour);
-	digit4.Draw(h0, clockfaceColour);
-	digit5.Draw(h1, clockfaceColour);
+unsigned long lastClockCheck = 0;
+unsigned long lastMorphStep = 0;
 
-	pNow = now;
+bool timestampsAreEqual(TimeInfo a, TimeInfo b) {
+	return a.second == b.second && a.minute == b.minute && a.hour == b.hour;
 }
 
-///////////////////
-// MAIN LOOP
-///////////////////
-void loop() {
-	// If an OTA update is in progress, skip this iteration of the loop
-	if (otaUpdateInProgress) {
-		vTaskDelay(10 / portTICK_PERIOD_MS);
-		return;
-	}
-
+// Starts morphing any digits that have changed since the last check
+void updateClock() {
 	DateTime rtcTime = rtc.now();
 	time_t utcTimestamp = rtcTime.unixtime();
 
@@ -364,8 +304,95 @@ void loop() {
 
 		pNow = now;
 	}
+}
+
+///////////////////
+// SETUP FUNCTION
+///////////////////
+void setup() {
+	setupMatrix();
+	loadMorphingClockConfig();
+
+	// Indicate that the app-specific configuration has been loaded
+	configIsLoaded = true;
+
+	clockfaceColour = dma_display->color565(morphingClockConfig.r, morphingClockConfig.g, morphingClockConfig.b);
+	digit0.init(0, 63 - 1 - 9 * 1, 9, clockfaceColour);
+	digit1.init(0, 63 - 1 - 9 * 2, 9, clockfaceColour);
+	digit2.init(0, 63 - 4 - 9 * 3, 9, clockfaceColour);
+	digit3.init(0, 63 - 4 - 9 * 4, 9, clockfaceColour);
+	digit4.init(0, 63 - 7 - 9 * 5, 9, clockfaceColour);
+	digit5.init(0, 63 - 7 - 9 * 6, 9, clockfaceColour);
+
+	DateTime rtcTime = rtc.now();
+	time_t utcTimestamp = rtcTime.unixtime();
+
+	struct tm tmNow;
+	localtime_r(&utcTimestamp, &tmNow);
+
+	TimeInfo now = getTimeInfo(tmNow);
+
+	int ss = now.second;
+	int mm = now.minute;
+	int hh = now.hour;
+
+	if (!globalConfig.is24h) {
+		if (hh > 12) {
+			hh -= 12;
+		}
+
+		// Convert 00:xx to 12:xx AM
+		if (hh == 0) {
+			hh = 12;
+		}
+	}
+
+	int s0 = ss % 10;
+	int s1 = ss / 10;
+	int m0 = mm % 10;
+	int m1 = mm / 10;
+	int h0 = hh % 10;
+	int h1 = hh / 10;
+
+	digit1.DrawColon(clockfaceColour);
+	digit3.DrawColon(clockfaceColour);
+	digit0.Draw(s0, clockfaceColour);
+	digit1.Draw(s1, clockfaceColour);
+	digit2.Draw(m0, clockfaceColour);
+	digit3.Draw(m1, clockfaceColour);
+	digit4.Draw(h0, clockfaceColour);
+	digit5.Draw(h1, clockfaceColour);
+
+	pNow = now;
+}
+
+///////////////////
+// MAIN LOOP
+///////////////////
+void loop() {
+	// If an OTA update is in progress, skip this iteration of the loop
+	if (otaUpdateInProgress) {
+		vTaskDelay(10 / portTICK_PERIOD_MS);
+		return;
+	}
+
+	unsigned long currentMillis = millis();
+
+	// Every digit that's changing morphs at the same time, one step per frame
+	if (currentMillis - lastMorphStep >= MORPH_STEP_TIME) {
+		for (Digit *digit : digits) {
+			digit->StepMorph();
+		}
+
+		lastMorphStep = currentMillis;
+	}
+
+	if (currentMillis - lastClockCheck >= CLOCK_CHECK_INTERVAL) {
+		updateClock();
+		lastClockCheck = currentMillis;
+	}
 
-	delay(150);
+	delay(1);
 }
 
 #endif
\ No newline at end of file
@@ -34,58 +34,36 @@
 #include "Arduino.h"
 #include "../lib/luxigrid.h"
 
-unsigned long lastTime = 0;
-unsigned long timerDelay = 8;
+// The game runs at a fixed rate, independent of how long each pass of loop() takes
+// If the loop falls too far behind (e.g. after an OTA update was cancelled), the missed ticks are dropped rather than run all at once
+#define PONG_CLOCK_TICK 30
+#define PONG_CLOCK_MAX_TICKS_PER_LOOP 5
 
-void drawNet() {
-	for (uint8_t i = 1; i < 32; i += 2) {
-		dma_display->drawPixel(31, i, dma_display->color565(75, 75, 75));
-	}
-}
+#define PONG_CLOCK_PADDLE_HEIGHT 8
+#define PONG_CLOCK_BALL_SIZE 2
 
-void drawPlayer(uint8_t x, uint8_t y) {
-	dma_display->fillRect(x, y, 2, 8, dma_display->color565(255, 255, 255));
-}
+unsigned long lastPhysicsTick = 0;
 
-void drawBall(uint8_t x, uint8_t y) {
-	dma_display->fillRect(x, y, 2, 2, dma_display->color565(255, 255, 255));
-}
+// The net and the time are drawn once into this layer, whenever the score changes
+// The ball and paddles are sprites drawn on top, and moving one only restores the layer under its old rectangle
+GFXcanvas16 clockLayer(64, 32);
+bool needsFullRedraw = true;
 
-float calculateEndPoint(float x, float y, float vx, float vy, bool hit) {
-	while (true) {
-		x += vx;
-		y += vy;
+struct Sprite {
+	int16_t x;
+	int16_t y;
+	uint8_t width;
+	uint8_t height;
 
-		if (hit) {
-			if (x >= 60 || x <= 2) {
-				return y;
-			}
-		} else {
-			if (x >= 62 || x <= 0) {
-				return y;
-			}
-		}
+	int16_t drawnX;
+	int16_t drawnY;
+	bool drawn;
+};
 
-		if (y >= 30 || y <= 0) {
-			vy = -vy;
-		}
-	}
-}
-
-void updateTime(uint8_t hour, uint8_t minute) {
-	static uint8_t prevHour = 255;
-	static uint8_t prevMinute = 255;
-
-	// Clear the screen if the time has changed
-	if (hour != prevHour || minute != prevMinute) {
-		dma_display->clearScreen();
-		prevHour = hour;
-		prevMinute = minute;
-	}
-
-	dma_display->setCursor(0, 5);
-	printCenteredText(String(hour) + " " + String(minute));
-}
+Sprite ballSprite = {0, 0, PONG_CLOCK_BALL_SIZE, PONG_CLOCK_BALL_SIZE};
+Sprite leftPlayerSprite = {0, 0, 2, PONG_CLOCK_PADDLE_HEIGHT};
+Sprite rightPlayerSprite = {62, 0, 2, PONG_CLOCK_PADDLE_HEIGHT};
+Sprite *sprites[] = {&ballSprite, &leftPlayerSprite, &rightPlayerSprite};
 
 float ballX, ballY;
 float leftPlayerTargetY, rightPlayerTargetY;
@@ -93,35 +71,34 @@ int16_t leftPlayerY, rightPlayerY;
 float ballVX, ballVY;
 int playerLoss, gameStopped;
 
-int prevBallX, prevBallY;
-int prevLeftPlayerY, prevRightPlayerY;
+// Where each player reacts to the ball on the far side of the court; picked afresh whenever the ball crosses the middle
+float leftPlayerReactX, rightPlayerReactX;
 
+// The score shown on screen, and the actual time, which is read from the RTC once a minute
 uint8_t hour, minute;
+uint8_t clockHour, clockMinute;
+unsigned long nextMinuteTime = 0;
 
-///////////////////
-// SETUP FUNCTION
-///////////////////
-void setup() {
-	setupMatrix();
-	dma_display->setFont(&Org_01);
+void drawClockLayer(uint8_t hour, uint8_t minute) {
+	clockLayer.fillScreen(0);
 
-	ballX = 31.0;
-	ballY = random(160) / 10.0 + 8.0;
-	leftPlayerTargetY = ballY;
-	rightPlayerTargetY = ballY;
-	leftPlayerY = 8;
-	rightPlayerY = 18;
-	ballVX = 1.0;
-	ballVY = 0.5;
+	for (uint8_t i = 1; i < 32; i += 2) {
+		clockLayer.drawPixel(31, i, dma_display->color565(75, 75, 75));
+	}
 
-	prevBallX = ballX;
-	prevBallY = ballY;
-	prevLeftPlayerY = leftPlayerY;
-	prevRightPlayerY = rightPlayerY;
+	String text = String(hour) + " " + String(minute);
+	int16_t x1, y1;
+	uint16_t w, h;
 
-	playerLoss = 0;
-	gameStopped = 0;
+	clockLayer.getTextBounds(text, 0, 0, &x1, &y1, &w, &h);
+	clockLayer.setCursor((clockLayer.width() - w) / 2, 5);
+	clockLayer.print(text);
+
+	needsFullRedraw = true;
+}
 
+// Reads the time from the RTC, and works out when the minute will next change
+void readClock() {
 	DateTime rtcTime = rtc.now();
 	time_t utcTimestamp = rtcTime.unixtime();
 
@@ -130,231 +107,289 @@ void setup() {
 
 	TimeInfo now = getTimeInfo(tmNow);
 
-	if (now.second > 29) {
+	clockHour = now.hour;
+	clockMinute = now.minute;
+	nextMinuteTime = millis() + (60 - now.second) * 1000UL;
+}
+
+float clampPaddleY(float y) {
+	return constrain(y, 0, 32 - PONG_CLOCK_PADDLE_HEIGHT);
+}
+
+// True if going from "from" to "to" reached or passed the given x position
+bool crossed(float from, float to, float x) {
+	return from != x && (from - x) * (to - x) <= 0;
+}
+
+// Where the ball will be when it reaches targetX, in constant time
+// Bounces off the top and bottom are exact reflections, so unfolding them turns the path into a straight line
+float predictBallY(float x, float y, float vx, float vy, float targetX) {
+	float steps = max(1.0f, ceilf((targetX - x) / vx));
+	float unfolded = fmodf(y + steps * vy, 60);
+
+	if (unfolded < 0) {
+		unfolded += 60;
+	}
+
+	return unfolded <= 30 ? unfolded : 60 - unfolded;
+}
+
+void resetRally() {
+	ballX = 31.0;
+	ballY = random(1000) / 1000.0 * 16 + 8;
+	ballVX = 1.0;
+	ballVY = 0.5;
+
+	if (random(2) == 0) {
 		ballVY = -0.5;
 	}
 
-	hour = now.hour;
-	minute = now.minute;
-	updateTime(hour, minute);
+	leftPlayerReactX = 40 + random(13);
+	rightPlayerReactX = 8 + random(13);
+
+	playerLoss = 0;
+	gameStopped = 0;
 }
 
-///////////////////
-// MAIN LOOP
-///////////////////
-void loop() {
-	// If an OTA update is in progress, skip this iteration of the loop
-	if (otaUpdateInProgress) {
-		vTaskDelay(10 / portTICK_PERIOD_MS);
+void stepPongClock() {
+	if (gameStopped < 20) {
+		gameStopped++;
 		return;
 	}
 
-	DateTime rtcTime = rtc.now();
-	time_t utcTimestamp = rtcTime.unixtime();
+	float previousX = ballX;
 
-	struct tm tmNow;
-	localtime_r(&utcTimestamp, &tmNow);
+	ballX += ballVX;
+	ballY += ballVY;
 
-	TimeInfo now = getTimeInfo(tmNow);
+	if ((ballX >= 60 && playerLoss != 1) || (ballX <= 2 && playerLoss != -1)) {
+		ballVX = -ballVX;
 
-	int hour = now.hour;
-
-	if ((millis() - lastTime) > timerDelay) {
-		lastTime = millis();
-
-		// Clear previous ball position (clearing whole screen every frame leads to flickering)
-		dma_display->fillRect(prevBallX, prevBallY, 2, 2, dma_display->color565(0, 0, 0));
-
-		// Clear previous left and right paddles positions
-		dma_display->fillRect(0, prevLeftPlayerY, 2, 8, dma_display->color565(0, 0, 0));
-		dma_display->fillRect(62, prevRightPlayerY, 2, 8, dma_display->color565(0, 0, 0));
-
-		if (gameStopped < 20) {
-			gameStopped++;
-		} else {
-			ballX += ballVX;
-			ballY += ballVY;
-
-			if ((ballX >= 60 && playerLoss != 1) || (ballX <= 2 && playerLoss != -1)) {
-				ballVX = -ballVX;
-
-				// Perform a random, last second flick to inflict effect on the ball
-				int tmp = random(4);
-
-				if (tmp > 0) {
-					tmp = random(2);
-
-					if (tmp == 0) {
-						if (ballVY > 0 && ballVY < 2.5) {
-							ballVY += 0.2;
-						} else if (ballVY < 0 && ballVY > -2.5) {
-							ballVY -= 0.2;
-						}
-
-						if (ballX >= 60) {
-							rightPlayerTargetY += 1 + 3 * (random(1000) / 1000.0);
-						} else {
-							leftPlayerTargetY += 1 + 3 * (random(1000) / 1000.0);
-						}
-					} else {
-						if (ballVY > 0.5) {
-							ballVY -= 0.2;
-						} else if (ballVY < -0.5) {
-							ballVY += 0.2;
-						}
-
-						if (ballX >= 60) {
-							rightPlayerTargetY -= 1 + 3 * (random(1000) / 1000.0);
-						} else {
-							leftPlayerTargetY -= 1 + 3 * (random(1000) / 1000.0);
-						}
-					}
-				}
+		// Perform a random, last second flick to inflict effect on the ball
+		int tmp = random(4);
+
+		if (tmp > 0) {
+			tmp = random(2);
 
-				if (leftPlayerTargetY < 0) {
-					leftPlayerTargetY = 0;
-				} else if (leftPlayerTargetY > 24) {
-					leftPlayerTargetY = 24;
+			if (tmp == 0) {
+				if (ballVY > 0 && ballVY < 2.5) {
+					ballVY += 0.2;
+				} else if (ballVY < 0 && ballVY > -2.5) {
+					ballVY -= 0.2;
 				}
 
-				if (rightPlayerTargetY < 0) {
-					rightPlayerTargetY = 0;
-				} else if (rightPlayerTargetY > 24) {
-					rightPlayerTargetY = 24;
+				if (ballX >= 60) {
+					rightPlayerTargetY += 1 + 3 * (random(1000) / 1000.0);
+				} else {
+					leftPlayerTargetY += 1 + 3 * (random(1000) / 1000.0);
 				}
-			} else if ((ballX > 62 && playerLoss == 1) || (ballX < 0 && playerLoss == -1)) {
-				// Reset Game
-				ballX = 31.0;
-				ballY = random(1000) / 1000.0 * 16 + 8;
-				ballVX = 1.0;
-				ballVY = 0.5;
-
-				if (random(2) == 0) {
-					ballVY = -0.5;
+			} else {
+				if (ballVY > 0.5) {
+					ballVY -= 0.2;
+				} else if (ballVY < -0.5) {
+					ballVY += 0.2;
 				}
 
-				hour = now.hour;
-				minute = now.minute;
+				if (ballX >= 60) {
+					rightPlayerTargetY -= 1 + 3 * (random(1000) / 1000.0);
+				} else {
+					leftPlayerTargetY -= 1 + 3 * (random(1000) / 1000.0);
+				}
+			}
+		}
 
-				updateTime(hour, minute);
+		leftPlayerTargetY = clampPaddleY(leftPlayerTargetY);
+		rightPlayerTargetY = clampPaddleY(rightPlayerTargetY);
+	} else if ((ballX > 62 && playerLoss == 1) || (ballX < 0 && playerLoss == -1)) {
+		// Reset Game, showing the new time
+		hour = clockHour;
+		minute = clockMinute;
+		drawClockLayer(hour, minute);
 
-				playerLoss = 0;
-				gameStopped = 0;
-			}
+		resetRally();
+		return;
+	}
 
-			if (ballY >= 30 || ballY <= 0) {
-				ballVY = -ballVY;
+	// Bounce off the top and bottom, reflecting any overshoot so predictBallY() stays exact
+	if (ballY >= 30) {
+		ballY = 60 - ballY;
+		ballVY = -ballVY;
+	} else if (ballY <= 0) {
+		ballY = -ballY;
+		ballVY = -ballVY;
+	}
+
+	// When the ball is on the other side of the court, move the player "randomly" to simulate an AI
+	if (crossed(previousX, ballX, leftPlayerReactX)) {
+		leftPlayerTargetY = clampPaddleY(ballY - 3);
+	}
+
+	if (crossed(previousX, ballX, rightPlayerReactX)) {
+		rightPlayerTargetY = clampPaddleY(ballY - 3);
+	}
+
+	if (static_cast<uint16_t>(leftPlayerTargetY) > leftPlayerY) {
+		leftPlayerY++;
+	} else if (static_cast<uint16_t>(leftPlayerTargetY) < leftPlayerY) {
+		leftPlayerY--;
+	}
+
+	if (static_cast<uint16_t>(rightPlayerTargetY) > rightPlayerY) {
+		rightPlayerY++;
+	} else if (static_cast<uint16_t>(rightPlayerTargetY) < rightPlayerY) {
+		rightPlayerY--;
+	}
+
+	// If the ball is in the middle, check if we need to lose and calculate the endpoint to avoid/hit the ball
+	if (crossed(previousX, ballX, 32)) {
+		leftPlayerReactX = 40 + random(13);
+		rightPlayerReactX = 8 + random(13);
+
+		if (minute != clockMinute && playerLoss == 0) {
+			if (clockMinute == 0) {
+				// Need to change the hour
+				playerLoss = 1;
+			} else {
+				// Need to change the minute
+				playerLoss = -1;
 			}
+		}
 
-			// When the ball is on the other side of the court, move the player "randomly" to simulate an AI
-			if (ballX == float(40 + random(13))) {
-				leftPlayerTargetY = ballY - 3;
+		// Moving to the left
+		if (ballVX < 0) {
+			leftPlayerTargetY = predictBallY(ballX, ballY, ballVX, ballVY, playerLoss != -1 ? 2 : 0) - 3;
 
-				if (leftPlayerTargetY < 0) {
-					leftPlayerTargetY = 0;
-				} else if (leftPlayerTargetY > 24) {
-					leftPlayerTargetY = 24;
+			// We need to lose
+			if (playerLoss == -1) {
+				if (leftPlayerTargetY < 16) {
+					leftPlayerTargetY = 19 + 5 * (random(1000) / 1000.0);
+				} else {
+					leftPlayerTargetY = 5 * (random(1000) / 1000.0);
 				}
 			}
 
-			if (ballX == float(8 + random(13))) {
-				rightPlayerTargetY = ballY - 3;
+			leftPlayerTargetY = clampPaddleY(leftPlayerTargetY);
+		}
+
+		// Moving to the right
+		if (ballVX > 0) {
+			rightPlayerTargetY = predictBallY(ballX, ballY, ballVX, ballVY, playerLoss != -1 ? 60 : 62) - 3;
 
-				if (rightPlayerTargetY < 0) {
-					rightPlayerTargetY = 0;
-				} else if (rightPlayerTargetY > 24) {
-					rightPlayerTargetY = 24;
+			// We need to lose
+			if (playerLoss == 1) {
+				if (rightPlayerTargetY < 16) {
+					rightPlayerTargetY = 19 + 5 * (random(1000) / 1000.0);
+				} else {
+					rightPlayerTargetY = 5 * (random(1000) / 1000.0);
 				}
 			}
 
-			if (static_cast<uint16_t>(leftPlayerTargetY) > leftPlayerY) {
-				leftPlayerY++;
-			} else if (static_cast<uint16_t>(leftPlayerTargetY) < leftPlayerY) {
-				leftPlayerY--;
-			}
+			rightPlayerTargetY = clampPaddleY(rightPlayerTargetY);
+		}
+	}
+}
 
-			if (static_cast<uint16_t>(rightPlayerTargetY) > rightPlayerY) {
-				rightPlayerY++;
-			} else if (static_cast<uint16_t>(rightPlayerTargetY) < rightPlayerY) {
-				rightPlayerY--;
+void restoreClockLayer(int16_t x, int16_t y, uint8_t width, uint8_t height) {
+	for (int16_t j = constrain(y, 0, 32); j < constrain(y + height, 0, 32); j++) {
+		for (int16_t i = constrain(x, 0, 64); i < constrain(x + width, 0, 64); i++) {
+			dma_display->drawPixel(i, j, clockLayer.getPixel(i, j));
+		}
+	}
+}
+
+void drawPongClock() {
+	ballSprite.x = ballX;
+	ballSprite.y = ballY;
+	leftPlayerSprite.y = leftPlayerY;
+	rightPlayerSprite.y = rightPlayerY;
+
+	bool moved = false;
+
+	if (needsFullRedraw) {
+		dma_display->drawRGBBitmap(0, 0, clockLayer.getBuffer(), clockLayer.width(), clockLayer.height());
+		needsFullRedraw = false;
+		moved = true;
+	} else {
+		// Put back whatever was under the sprites that have moved
+		for (Sprite *sprite : sprites) {
+			if (sprite->drawn && (sprite->x != sprite->drawnX || sprite->y != sprite->drawnY)) {
+				restoreClockLayer(sprite->drawnX, sprite->drawnY, sprite->width, sprite->height);
+				moved = true;
 			}
+		}
+	}
 
-			// If the ball is in the middle, check if we need to lose and calculate the endpoint to avoid/hit the ball
-			if (ballX == 32) {
-				if (minute != now.minute && playerLoss == 0) {
-					if (now.minute == 0) {
-						// Need to change the hour
-						playerLoss = 1;
-					} else {
-						// Need to change the minute
-						playerLoss = -1;
-					}
-				}
+	if (!moved) {
+		return;
+	}
 
-				// Moving to the left
-				if (ballVX < 0) {
-					leftPlayerTargetY = calculateEndPoint(ballX, ballY, ballVX, ballVY, playerLoss != -1) - 3;
-
-					// We need to lose
-					if (playerLoss == -1) {
-						if (leftPlayerTargetY < 16) {
-							leftPlayerTargetY = 19 + 5 * (random(1000) / 1000.0);
-						} else {
-							leftPlayerTargetY = 5 * (random(1000) / 1000.0);
-						}
-					}
-
-					if (leftPlayerTargetY < 0) {
-						leftPlayerTargetY = 0;
-					} else if (leftPlayerTargetY > 24) {
-						leftPlayerTargetY = 24;
-					}
-				}
+	// Draw all of them again, in case one was partly restored over another
+	for (Sprite *sprite : sprites) {
+		dma_display->fillRect(sprite->x, sprite->y, sprite->width, sprite->height, dma_display->color565(255, 255, 255));
 
-				// Moving to the right
-				if (ballVX > 0) {
-					rightPlayerTargetY = calculateEndPoint(ballX, ballY, ballVX, ballVY, playerLoss != -1) - 3;
-
-					// We need to lose
-					if (playerLoss == 1) {
-						if (rightPlayerTargetY < 16) {
-							rightPlayerTargetY = 19 + 5 * (random(1000) / 1000.0);
-						} else {
-							rightPlayerTargetY = 5 * (random(1000) / 1000.0);
-						}
-					}
-
-					if (rightPlayerTargetY < 0) {
-						rightPlayerTargetY = 0;
-					} else if (rightPlayerTargetY > 24) {
-						rightPlayerTargetY = 24;
-					}
-				}
-			}
+		sprite->drawnX = sprite->x;
+		sprite->drawnY = sprite->y;
+		sprite->drawn = true;
+	}
+}
 
-			if (ballY < 0) {
-				ballY = 0;
-			}
+///////////////////
+// SETUP FUNCTION
+///////////////////
+void setup() {
+	setupMatrix();
+	clockLayer.setFont(&Org_01);
 
-			if (ballY > 30) {
-				ballY = 30;
-			}
+	resetRally();
+
+	leftPlayerTargetY = ballY;
+	rightPlayerTargetY = ballY;
+	leftPlayerY = 8;
+	rightPlayerY = 18;
+
+	readClock();
+
+	hour = clockHour;
+	minute = clockMinute;
+	drawClockLayer(hour, minute);
+
+	lastPhysicsTick = millis();
+}
+
+///////////////////
+// MAIN LOOP
+///////////////////
+void loop() {
+	// If an OTA update is in progress, skip this iteration of the loop
+	// The OTA screen draws over everything, so redraw the whole screen afterwards
+	if (otaUpdateInProgress) {
+		needsFullRedraw = true;
+		vTaskDelay(10 / portTICK_PERIOD_MS);
+		return;
+	}
+
+	unsigned long currentMillis = millis();
+
+	// Signed comparison, so this keeps working when millis() wraps around
+	if ((long)(currentMillis - nextMinuteTime) >= 0) {
+		readClock();
+	}
+
+	uint8_t ticks = 0;
+
+	while (currentMillis - lastPhysicsTick >= PONG_CLOCK_TICK) {
+		if (ticks++ == PONG_CLOCK_MAX_TICKS_PER_LOOP) {
+			lastPhysicsTick = currentMillis;
+			break;
 		}
 
-		// Show stuff on the display
-		drawNet();
-		drawPlayer(0, leftPlayerY);
-		drawPlayer(62, rightPlayerY);
-		drawBall(ballX, ballY);
-		updateTime(hour, minute);
-
-		prevBallX = ballX;
-		prevBallY = ballY;
-		prevLeftPlayerY = leftPlayerY;
-		prevRightPlayerY = rightPlayerY;
+		stepPongClock();
+		lastPhysicsTick += PONG_CLOCK_TICK;
 	}
 
-	delay(30);
+	drawPongClock();
+
+	delay(1);
 }
 
-#endif
\ No newline at end of file
+#endif
@@ -33,18 +33,50 @@
 
 #include "Arduino.h"
 #include "../lib/luxigrid.h"
+#include "../lib/data-fetcher.hpp"
+#include "../lib/marquee.hpp"
 
 #include <WiFiUdp.h>
 #include <HTTPClient.h>
+#include <NetworkClientSecure.h>
 
-String payload = "";
-double current = 0;
+// The Finnhub API endpoint can be overridden with build_flags (e.g. -D FINNHUB_API_HOST=\"192.168.1.10\" -D FINNHUB_API_PORT=8080 -D FINNHUB_API_INSECURE_HTTP)
+// That way the stock ticker can be pointed at a local plain-HTTP stand-in for testing, without burning through the real API's rate limit
+#ifndef FINNHUB_API_HOST
+#define FINNHUB_API_HOST "finnhub.io"
+#endif
 
-unsigned long previousTime = 0;
+#ifndef FINNHUB_API_PORT
+#define FINNHUB_API_PORT 443
+#endif
 
-JsonDocument doc;
+// How long to wait for the initial TCP connection/TLS handshake and for each response, in milliseconds
+#define FINNHUB_CONNECT_TIMEOUT 5000
+#define FINNHUB_RESPONSE_TIMEOUT 5000
+
+// Finnhub's free tier allows 60 requests per minute; stay a bit under it, since the web interface also tests tickers with the same token
+#define FINNHUB_REQUESTS_PER_MINUTE 50
+// How many requests can be sent back-to-back, e.g. to fill in every price after startup
+#define FINNHUB_BURST_SIZE 10
+
+// Only hold the connection open if the next quote request is coming up within this many milliseconds
+#define FINNHUB_KEEP_ALIVE_WINDOW 10000
+
+// The maximum number of stocks that can be configured
+// Quotes are spread evenly across the refresh interval, so even at the minimum interval of a minute this stays well under the rate limit
+#define MAX_STOCKS 16
+
+// Only ever used by the quote fetcher (on the fetcher task); anything else that talks to Finnhub needs its own client
 HTTPClient http;
 
+// A single persistent connection to the Finnhub API, reused for every quote request
+// HTTPClient keeps it open between requests (HTTP/1.1 keep-alive), so only the first quote of a refresh pays for the TLS handshake
+#ifdef FINNHUB_API_INSECURE_HTTP
+NetworkClient finnhubClient;
+#else
+NetworkClientSecure finnhubClient;
+#endif
+
 struct StockPrice {
 	double currentPrice;
 	double percentChange;
@@ -66,7 +98,7 @@ struct StockInfo {
 struct StockTickerConfig {
 	unsigned long refreshInterval;
 	char apiToken[41];
-	StockInfo stocks[8];
+	StockInfo stocks[MAX_STOCKS];
 	uint8_t numberOfStocks;
 	// Delay between stocks
 	unsigned long stockDuration;
@@ -93,8 +125,37 @@ bool stocksAreValid = true;
 
 // Whether the Finnhub API rate limit has been reached
 // Under normal conditions this should never occur, but just in case handle it
+// It's cleared again as soon as a quote request goes through
 bool rateLimitReached = false;
 
+// Everything learned from one refresh of the stock prices
+// The fetcher task fills in its own copy and publishes it to stockTickerSlot; loop() picks it up from there
+struct StockTickerData {
+	StockPrice prices[MAX_STOCKS];
+	// Whether every stock has had its price fetched at least once
+	bool hasPrices;
+	bool isOnline;
+	bool tokenIsValid;
+	bool stocksAreValid;
+	bool rateLimitReached;
+};
+
+// Only ever touched by the fetcher task
+StockTickerData fetchedStockTickerData;
+unsigned long lastQuoteTime[MAX_STOCKS];
+bool quoteFetched[MAX_STOCKS];
+TokenBucket finnhubRateLimit;
+
+// The stock that loop() will show next; its price is refreshed ahead of the others when it's due
+volatile uint8_t upcomingStock = 0;
+
+// The latest data picked up by loop()
+StockTickerData stockTickerData;
+uint32_t stockTickerDataVersion = 0;
+
+DataSlot<StockTickerData> stockTickerSlot;
+FetchJob stockPriceJob;
+
 bool importStockTickerConfig(const JsonDocument &jsonDoc) {
 	// If the refreshInterval, apiToken, or stocks properties are invalid
 	if (!jsonDoc["refreshInterval"].is<unsigned long>() || !jsonDoc["apiToken"].is<const char *>() || strlen(jsonDoc["apiToken"]) >= sizeof(stockTickerConfig.apiToken) || !jsonDoc["stocks"].is<JsonArrayConst>() || !jsonDoc["stockDuration"].is<unsigned long>()) {
@@ -151,7 +212,7 @@ bool importStockTickerConfig(const JsonDocument &jsonDoc) {
 	stockTickerConfig.stockDuration = jsonDoc["stockDuration"].as<unsigned long>();
 
 	// numberOfStocks is the relevant length of the stocks array
-	// Because the array can store *up to* 8 stocks, but that doesn't mean it always has that many
+	// Because the array can store *up to* MAX_STOCKS stocks, but that doesn't mean it always has that many
 	stockTickerConfig.numberOfStocks = (uint8_t)index;
 
 	return true;
@@ -274,9 +335,27 @@ void validateAppConfig(AsyncWebServerRequest *request, bool &shouldSaveConfig) {
 		}
 
 		// Test Finnhub API token with a known good ticker (AAPL for Apple)
-		http.begin("https://finnhub.io/api/v1/quote?symbol=AAPL&token=" + String(apiTokenString));
-
-		int httpCode = http.GET();
+		// This uses its own client and connection; the shared http/finnhubClient pair belongs to the quote fetcher
+#ifdef FINNHUB_API_INSECURE_HTTP
+		NetworkClient tokenCheckClient;
+#else
+		NetworkClientSecure tokenCheckClient;
+		tokenCheckClient.setInsecure();
+#endif
+
+		HTTPClient tokenCheck;
+		tokenCheck.setReuse(false);
+		tokenCheck.setConnectTimeout(FINNHUB_CONNECT_TIMEOUT);
+		tokenCheck.setTimeout(FINNHUB_RESPONSE_TIMEOUT);
+
+#ifdef FINNHUB_API_INSECURE_HTTP
+		tokenCheck.begin(tokenCheckClient, FINNHUB_API_HOST, FINNHUB_API_PORT, "/api/v1/quote?symbol=AAPL&token=" + String(apiTokenString), false);
+#else
+		tokenCheck.begin(tokenCheckClient, FINNHUB_API_HOST, FINNHUB_API_PORT, "/api/v1/quote?symbol=AAPL&token=" + String(apiTokenString), true);
+#endif
+
+		int httpCode = tokenCheck.GET();
+		tokenCheck.end();
 
 		// Require the token to be validated against the Finnhub API here, unless currently offline
 		if (httpCode == 200 || wifiConfig.isAccessPoint) {
@@ -287,8 +366,6 @@ void validateAppConfig(AsyncWebServerRequest *request, bool &shouldSaveConfig) {
 			shouldRestart = true;
 			return;
 		}
-
-		http.end();
 	}
 
 	if (request->hasParam("refreshInterval", true)) {
@@ -330,7 +407,7 @@ void validateAppConfig(AsyncWebServerRequest *request, bool &shouldSaveConfig) {
 		uint8_t index = 0;
 		bool stocksAreValid = true;
 		for (JsonObject stock : jsonDoc.as<JsonArray>()) {
-			// If more than 8 stocks, skip any extras
+			// If more than MAX_STOCKS stocks, skip any extras
 			if (index >= sizeof(stockTickerConfig.stocks) / sizeof(stockTickerConfig.stocks[0])) {
 				stocksAreValid = false;
 				break;
@@ -460,15 +537,15 @@ String formatPercentageChange(double value) {
 	return String(value, 0);
 }
 
+// The company name along the top row, leaving a 1 pixel margin on either side
+Marquee companyNameMarquee(1, 6, 62, 5, 1);
+
 void printStockInfo(StockInfo currentStockInfo) {
 	dma_display->clearScreen();
 
-	// Print company name
+	// Print company name, scrolling it if it's too long to fit
 	dma_display->setTextSize(1);
-	dma_display->setCursor(0, 6);
-	dma_display->setTextColor(dma_display->color565(155, 155, 155));
-	dma_display->setFont(&TomThumb);
-	printCenteredTruncatedText(currentStockInfo.companyName, 1, "...");
+	companyNameMarquee.setText(currentStockInfo.companyName, &TomThumb, dma_display->color565(155, 155, 155));
 	dma_display->setFont(&Org_01);
 
 	int16_t middleRow = 16;
@@ -476,19 +553,14 @@ void printStockInfo(StockInfo currentStockInfo) {
 	// Print ticker
 	dma_display->setCursor(1, middleRow);
 	dma_display->setTextColor(dma_display->color565(currentStockInfo.brandColour.r, currentStockInfo.brandColour.g, currentStockInfo.brandColour.b));
-	dma_display->print(currentStockInfo.ticker);
+	printText(currentStockInfo.ticker);
 
 	dma_display->setTextColor(dma_display->color565(255, 255, 255));
 
-	int16_t x1, y1;
-	uint16_t w, h;
-
 	// Use the absolute value with the formatPercentChange function
 	String percentChange = formatPercentageChange(fabs(currentStockInfo.price.percentChange));
 
-	dma_display->getTextBounds(percentChange, 0, 0, &x1, &y1, &w, &h);
-
-	int16_t textStart = dma_display->width() - (int16_t)w - 4;
+	int16_t textStart = dma_display->width() - (int16_t)measureText(percentChange) - 4;
 
 	int16_t xPosition = textStart - 11;
 	int16_t yPosition = dma_display->getCursorY();
@@ -527,7 +599,7 @@ void printStockInfo(StockInfo currentStockInfo) {
 
 	// Print percent change
 	dma_display->setCursor(textStart, middleRow);
-	dma_display->print(percentChange);
+	printText(percentChange);
 
 	uint16_t percentSignColour = changeIsPositive ? dma_display->color565(0, 155, 0) : changeIsZero ? dma_display->color565(0, 0, 155)
 	                                                                                                : dma_display->color565(155, 0, 0);
@@ -548,7 +620,13 @@ void printStockInfo(StockInfo currentStockInfo) {
 		return;
 	}
 
-	delay(stockTickerConfig.stockDuration);
+	delayWithMarquees(stockTickerConfig.stockDuration);
+	companyNameMarquee.stop();
+
+	// Don't sweep over the OTA update box, if an update has started in the meantime
+	if (otaUpdateInProgress) {
+		return;
+	}
 
 	if (stockTickerConfig.numberOfStocks != 1) {
 		// Sweep the stock away with a horizontal line before the next stock
@@ -560,55 +638,232 @@ void printStockInfo(StockInfo currentStockInfo) {
 	}
 }
 
-void refreshStockPrice(StockInfo &stockInfo) {
-	float percentchange;
+// Configure the persistent Finnhub client and the HTTPClient that drives it
+void setupFinnhubClient() {
+#ifndef FINNHUB_API_INSECURE_HTTP
+	// Matches the previous behaviour of HTTPClient::begin(url) without a CA certificate
+	finnhubClient.setInsecure();
+	finnhubClient.setHandshakeTimeout(FINNHUB_CONNECT_TIMEOUT / 1000);
+#endif
 
-	http.begin("https://finnhub.io/api/v1/quote?symbol=" + String(stockInfo.ticker) + "&token=" + String(stockTickerConfig.apiToken));
+	// Keep the connection open after each response, so the next quote is sent over the same socket
+	http.setReuse(true);
+	http.setConnectTimeout(FINNHUB_CONNECT_TIMEOUT);
+	http.setTimeout(FINNHUB_RESPONSE_TIMEOUT);
+
+	// Needed to know how long to back off for, if the rate limit is hit
+	const char *headerKeys[] = {"Retry-After"};
+	http.collectHeaders(headerKeys, 1);
+
+	finnhubRateLimit.begin(FINNHUB_BURST_SIZE, FINNHUB_REQUESTS_PER_MINUTE);
+}
+
+FetchResult refreshStockPrice(const StockInfo &stockInfo, StockPrice &price, StockTickerData &data) {
+	String uri = "/api/v1/quote?symbol=" + String(stockInfo.ticker) + "&token=" + String(stockTickerConfig.apiToken);
+
+	// Passing the same client and host each time lets HTTPClient skip reconnecting while the previous connection is still alive
+#ifdef FINNHUB_API_INSECURE_HTTP
+	http.begin(finnhubClient, FINNHUB_API_HOST, FINNHUB_API_PORT, uri, false);
+#else
+	http.begin(finnhubClient, FINNHUB_API_HOST, FINNHUB_API_PORT, uri, true);
+#endif
 
 	int httpCode = http.GET();
 
 	if (httpCode == 200) {
-		payload = http.getString();
-		char inp[payload.length()];
-		payload.toCharArray(inp, payload.length());
-		deserializeJson(doc, inp);
-
 		// c = Current price, d = Change, dp = Percent change, pc = Previous close price
-		String v = doc["c"];
-		String c = doc["dp"];
-		current = v.toDouble();
-		percentchange = c.toDouble();
+		// Only c and dp are used, so everything else is discarded while parsing instead of being stored in the document
+		JsonDocument filter;
+		filter["c"] = true;
+		filter["dp"] = true;
+
+		JsonDocument quote;
+		DeserializationError deserializationError;
+
+		// Parse straight from the connection when the response has a Content-Length
+		// A chunked response has to be de-chunked by HTTPClient first, since the raw stream would contain the chunk headers
+		if (http.getSize() > 0) {
+			deserializationError = deserializeJson(quote, http.getStream(), DeserializationOption::Filter(filter));
+		} else {
+			deserializationError = deserializeJson(quote, http.getString(), DeserializationOption::Filter(filter));
+		}
+
+		if (deserializationError) {
+			Serial.println("Invalid Quote Response - " + String(stockInfo.ticker) + " - " + deserializationError.c_str());
+			data.isOnline = false;
+			http.end();
+			finnhubClient.stop();
+			return FETCH_RETRY;
+		}
 
 		// An invalid stock returns something like this: {"c":0,"d":null,"dp":null}
-		if (v == "0" || c == "null") {
+		if (quote["c"].as<double>() == 0 || quote["dp"].isNull()) {
 			Serial.println("Invalid Stock - " + String(stockInfo.ticker));
-			stocksAreValid = false;
+			data.stocksAreValid = false;
 			http.end();
-			return;
+			return FETCH_FAILED;
 		}
 
-		Serial.println(payload);
+		price.currentPrice = quote["c"].as<double>();
+		price.percentChange = quote["dp"].as<double>();
 
-		stockInfo.price.currentPrice = current;
-		stockInfo.price.percentChange = percentchange;
+		Serial.printf("%s: %.2f (%.2f%%)\n", stockInfo.ticker, price.currentPrice, price.percentChange);
 
-		isOnline = true;
-	} else {
-		Serial.println("HTTP GET request failed");
-		Serial.println("HTTP Response Code: " + String(httpCode));
-
-		// A 401 error indicates an invalid API token; a 429 indicates going over the rate limit
-		// Any other errors indicate some kind of internet connectivity problem
-		if (httpCode == 401) {
-			tokenIsValid = false;
-		} else if (httpCode == 429) {
-			rateLimitReached = true;
-		} else {
-			isOnline = false;
-		}
+		data.isOnline = true;
+		http.end();
+		return FETCH_OK;
 	}
 
+	Serial.println("HTTP GET request failed");
+	Serial.println("HTTP Response Code: " + String(httpCode));
+
+	// How long Finnhub wants us to wait, if this was a rate limit response
+	long retryAfter = http.header("Retry-After").toInt();
+
+	// Don't try to reuse a connection that just failed; the next request will open a fresh one
 	http.end();
+	finnhubClient.stop();
+
+	// A 401 error indicates an invalid API token; a 429 indicates going over the rate limit
+	// Any other errors indicate some kind of internet connectivity problem
+	if (httpCode == 401) {
+		data.tokenIsValid = false;
+		return FETCH_FAILED;
+	} else if (httpCode == 429) {
+		data.rateLimitReached = true;
+
+		// Hold off for as long as Finnhub asks, or for a full rate limit window if it doesn't say
+		stockPriceJob.runAgainIn = retryAfter > 0 ? retryAfter * 1000 : 60000;
+		finnhubRateLimit.empty();
+
+		return FETCH_FAILED;
+	}
+
+	data.isOnline = false;
+	return FETCH_RETRY;
+}
+
+// Whether a stock's price is old enough to be refreshed
+// Half an interval of slack keeps the schedule from slipping by one slot whenever a request takes a little longer
+bool stockIsDue(uint8_t index, unsigned long currentMillis) {
+	return !quoteFetched[index] || currentMillis - lastQuoteTime[index] >= stockTickerConfig.refreshInterval - stockPriceJob.interval / 2;
+}
+
+// Choose which stock to refresh next: the one about to be shown if it's due, otherwise whichever price is the most out of date
+// Returns -1 if every price is still fresh
+int8_t pickStockToRefresh() {
+	unsigned long currentMillis = millis();
+	uint8_t upcoming = upcomingStock < stockTickerConfig.numberOfStocks ? upcomingStock : 0;
+
+	if (stockIsDue(upcoming, currentMillis)) {
+		return upcoming;
+	}
+
+	int8_t stalest = -1;
+	unsigned long stalestAge = 0;
+
+	for (uint8_t x = 0; x < stockTickerConfig.numberOfStocks; x++) {
+		if (!quoteFetched[x]) {
+			return x;
+		}
+
+		unsigned long age = currentMillis - lastQuoteTime[x];
+
+		if (stockIsDue(x, currentMillis) && age >= stalestAge) {
+			stalest = x;
+			stalestAge = age;
+		}
+	}
+
+	return stalest;
+}
+
+// Fetch job that refreshes one stock's price per run; runs on the data fetcher task
+// The job's interval is the refresh interval divided by the number of stocks, so requests are spread out evenly instead of all at once
+FetchResult fetchStockPrices(uint16_t timeout) {
+	StockTickerData &data = fetchedStockTickerData;
+
+	// Once either of these is hit, there's no point in asking again until the config changes (which restarts the app)
+	if (!data.tokenIsValid || !data.stocksAreValid) {
+		return FETCH_FAILED;
+	}
+
+	int8_t index = pickStockToRefresh();
+
+	// Every price is up to date
+	if (index < 0) {
+		finnhubClient.stop();
+		return FETCH_OK;
+	}
+
+	// Wait for the rate limit to allow another request
+	if (!finnhubRateLimit.tryTake()) {
+		stockPriceJob.runAgainIn = finnhubRateLimit.waitTime();
+		return FETCH_OK;
+	}
+
+	http.setTimeout(timeout);
+
+	FetchResult result = refreshStockPrice(stockTickerConfig.stocks[index], data.prices[index], data);
+
+	if (result == FETCH_OK) {
+		lastQuoteTime[index] = millis();
+		quoteFetched[index] = true;
+
+		// A request went through, so whatever rate limiting there was is over
+		data.rateLimitReached = false;
+
+		data.hasPrices = true;
+		for (uint8_t x = 0; x < stockTickerConfig.numberOfStocks; x++) {
+			data.hasPrices = data.hasPrices && quoteFetched[x];
+		}
+
+		// If other prices are overdue (after startup, or after being offline for a while), catch up as fast as the rate limit allows
+		if (pickStockToRefresh() >= 0) {
+			stockPriceJob.runAgainIn = max(finnhubRateLimit.waitTime(), 100UL);
+		}
+
+		// Hold on to the connection only if it's about to be used again; otherwise Finnhub will drop it anyway
+		unsigned long nextRequestIn = stockPriceJob.runAgainIn > 0 ? stockPriceJob.runAgainIn : stockPriceJob.interval;
+
+		if (nextRequestIn > FINNHUB_KEEP_ALIVE_WINDOW) {
+			finnhubClient.stop();
+		}
+	}
+
+	// A transient failure shouldn't replace prices that are already on screen; the fetcher will retry shortly
+	// But if nothing has been shown yet, publish it so the connection issue is reported instead of loading forever
+	if (result == FETCH_RETRY && data.hasPrices) {
+		data.isOnline = true;
+		return result;
+	}
+
+	stockTickerSlot.publish(data);
+
+	return result;
+}
+
+// Pick up the latest data from the fetcher, if anything new has been published
+// Returns true if the status changed (e.g. going offline, or the first prices coming in), meaning a different screen should be shown
+bool pullStockTickerData() {
+	bool hadPrices = stockTickerData.hasPrices;
+	bool wasOnline = isOnline;
+	bool wasRateLimited = rateLimitReached;
+
+	if (!stockTickerSlot.consume(stockTickerData, stockTickerDataVersion)) {
+		return false;
+	}
+
+	isOnline = stockTickerData.isOnline;
+	tokenIsValid = stockTickerData.tokenIsValid;
+	stocksAreValid = stockTickerData.stocksAreValid;
+	rateLimitReached = stockTickerData.rateLimitReached;
+
+	for (uint8_t x = 0; x < stockTickerConfig.numberOfStocks; x++) {
+		stockTickerConfig.stocks[x].price = stockTickerData.prices[x];
+	}
+
+	return hadPrices != stockTickerData.hasPrices || wasOnline != isOnline || wasRateLimited != rateLimitReached || !tokenIsValid || !stocksAreValid;
 }
 
 const char *loading = "LOADING";
@@ -637,27 +892,28 @@ void getNextColor(uint8_t &r, uint8_t &g, uint8_t &b) {
 	}
 }
 
-bool showLoadingAnimation = false;
 Colour loadingLetterColours[7];
 
-void playLoadingAnimation(void *pvParameters) {
-	for (;;) {
-		if (showLoadingAnimation) {
-			x = 12;
+// Shown until the first batch of prices arrives from the fetcher
+void playLoadingAnimation() {
+	// If an OTA update is in progress, return from this function
+	if (otaUpdateInProgress) {
+		return;
+	}
 
-			for (int i = 0; loading[i] != '\0'; i++) {
-				getNextColor(loadingLetterColours[i].r, loadingLetterColours[i].g, loadingLetterColours[i].b);
+	dma_display->setFont(&Org_01);
+	x = 12;
 
-				setTextColor(loadingLetterColours[i].r, loadingLetterColours[i].g, loadingLetterColours[i].b);
+	for (int i = 0; loading[i] != '\0'; i++) {
+		getNextColor(loadingLetterColours[i].r, loadingLetterColours[i].g, loadingLetterColours[i].b);
 
-				dma_display->setCursor(x, y);
-				dma_display->print(loading[i]);
+		setTextColor(loadingLetterColours[i].r, loadingLetterColours[i].g, loadingLetterColours[i].b);
 
-				x += 6;
-				delay(75);
-			}
-		}
-		vTaskDelay(10 / portTICK_PERIOD_MS);
+		dma_display->setCursor(x, y);
+		dma_display->print(loading[i]);
+
+		x += 6;
+		delay(75);
 	}
 }
 
@@ -913,15 +1169,6 @@ void setup() {
 
 	dma_display->setFont(&Org_01);
 
-	xTaskCreate(
-	    playLoadingAnimation,  // Function that should be executed
-	    "LoadingAnimation",    // Name of the task (for debugging)
-	    2048,                  // Stack size in bytes
-	    NULL,                  // Parameter passed into the task
-	    1,                     // Task priority
-	    NULL                   // Task handle
-	);
-
 	// For now, assume we are online until a network issue is encountered
 	isOnline = !wifiConfig.isAccessPoint;
 
@@ -932,6 +1179,29 @@ void setup() {
 	tokenIsUnset = !tokenIsValid;
 
 	noStocks = stockTickerConfig.numberOfStocks == 0;
+
+	fetchedStockTickerData.hasPrices = false;
+	fetchedStockTickerData.isOnline = isOnline;
+	fetchedStockTickerData.tokenIsValid = tokenIsValid;
+	fetchedStockTickerData.stocksAreValid = stocksAreValid;
+	fetchedStockTickerData.rateLimitReached = rateLimitReached;
+	stockTickerData = fetchedStockTickerData;
+
+	// The stock prices are fetched in the background, so the display keeps animating during a refresh
+	if (!wifiConfig.isAccessPoint && !tokenIsUnset && !noStocks) {
+		setupFinnhubClient();
+
+		stockPriceJob.name = "stockPrices";
+		stockPriceJob.run = fetchStockPrices;
+		stockPriceJob.interval = stockTickerConfig.refreshInterval / stockTickerConfig.numberOfStocks;
+		stockPriceJob.timeout = FINNHUB_RESPONSE_TIMEOUT;
+		stockPriceJob.maxRetries = 5;
+		stockPriceJob.retryDelay = 2000;
+		stockPriceJob.maxRetryDelay = 60000;
+
+		addFetchJob(&stockPriceJob);
+		startDataFetcher();
+	}
 }
 
 ///////////////////
@@ -944,24 +1214,8 @@ void loop() {
 		return;
 	}
 
-	unsigned long currentTime = millis();
-
-	if (!wifiConfig.isAccessPoint && tokenIsValid && !noStocks && stocksAreValid && !rateLimitReached && (previousTime == 0 || (currentTime - previousTime >= stockTickerConfig.refreshInterval && stockTickerConfig.refreshInterval >= 60000))) {
-		showLoadingAnimation = true;
-		Serial.println("Refreshing Data");
-
-		for (uint8_t x = 0; x < stockTickerConfig.numberOfStocks; x++) {
-			if (tokenIsValid && stocksAreValid && !rateLimitReached) {
-				refreshStockPrice(stockTickerConfig.stocks[x]);
-				delay(150);
-			}
-		}
-
-		previousTime = currentTime;
-
-		// Stop the loading animation and clear the screen
-		showLoadingAnimation = false;
-		delay(500);
+	// Start from a clean screen whenever the status changes, e.g. to clear away the loading animation or a previous error message
+	if (pullStockTickerData()) {
 		dma_display->clearScreen();
 	}
 
@@ -975,8 +1229,11 @@ void loop() {
 		playNoStocksAnimation();
 	} else if (!stocksAreValid) {
 		playStocksAreInvalidAnimation();
-	} else if (rateLimitReached) {
+	} else if (rateLimitReached && !stockTickerData.hasPrices) {
+		// Once there are prices to show, keep showing them while the fetcher waits out the rate limit
 		playRateLimitReachedAnimation();
+	} else if (isOnline && !stockTickerData.hasPrices) {
+		playLoadingAnimation();
 	} else if (isOnline) {
 		for (uint8_t x = 0; x < stockTickerConfig.numberOfStocks; x++) {
 			// If an OTA update is in progress, break out of the loop
@@ -984,6 +1241,17 @@ void loop() {
 				break;
 			}
 
+			// Fresh prices can land at any time; show them from the next stock onwards
+			pullStockTickerData();
+
+			if (!isOnline || !tokenIsValid || !stocksAreValid) {
+				dma_display->clearScreen();
+				break;
+			}
+
+			// Let the fetcher know which price to prioritise while this one is on screen
+			upcomingStock = (x + 1) % stockTickerConfig.numberOfStocks;
+
 			printStockInfo(stockTickerConfig.stocks[x]);
 		}
 	} else {
@@ -43,6 +43,8 @@
 
 #include "Arduino.h"
 #include "../lib/luxigrid.h"
+#include "../lib/data-fetcher.hpp"
+#include "../lib/marquee.hpp"
 
 #include <WiFiUdp.h>
 #include <HTTPClient.h>
@@ -309,13 +311,73 @@ void saveAppConfig() {
 	}
 }
 
-unsigned long lastTime = 0;
-
 int temp, hum, press;
 float wind_speed;
 int pop;
 uint16_t weather_code;
 
+// The conditions from one Open-Meteo request, handed from the fetcher task to loop() through weatherSlot
+struct WeatherData {
+	int temp;
+	int hum;
+	int press;
+	float windSpeed;
+	int pop;
+	uint16_t weatherCode;
+	bool isOnline;
+};
+
+// Only ever touched by the fetcher task
+WeatherData fetchedWeatherData;
+bool hasWeatherData = false;
+
+// How many hours of forecast to request; later hours are answered from this window without asking Open-Meteo again
+#define FORECAST_HOURS 12
+
+// How long the "current" conditions from a response are shown before switching over to the hourly forecast
+#define CURRENT_CONDITIONS_LIFETIME 3600
+
+struct WeatherConditions {
+	float temperature;
+	uint8_t humidity;
+	uint16_t pressure;
+	float windSpeed;
+	uint8_t pop;
+	uint16_t weatherCode;
+};
+
+// HTTP validators for revalidating a cached response with a conditional GET
+struct ResponseValidators {
+	char etag[64];
+	char lastModified[32];
+	// From Cache-Control, in seconds (0 if the response didn't say)
+	unsigned long maxAge;
+};
+
+// The parsed fields from the last Open-Meteo response, saved to the SD card so they're available again right after a reboot
+struct WeatherCache {
+	bool isValid;
+	ResponseValidators validators;
+	// Unix timestamps
+	time_t fetchedAt;
+	time_t expiresAt;
+	time_t firstHour;
+	WeatherConditions current;
+	uint8_t hours;
+	WeatherConditions hourly[FORECAST_HOURS];
+};
+
+WeatherCache weatherCache;
+const char *weatherCacheFilename = "/cache/weather_station.json";
+
+// The current Unix time, kept up to date by loop() so the fetcher task doesn't have to share the RTC's I2C bus
+// 32 bits, so it's read and written in one go
+volatile uint32_t currentUnixTime = 0;
+
+DataSlot<WeatherData> weatherSlot;
+uint32_t weatherDataVersion = 0;
+FetchJob weatherJob;
+
 char timeBuffer[50];
 char dateBuffer[50];
 
@@ -338,6 +400,9 @@ bool showDataAttribution = true;
 unsigned long lastAttributionTime = 0;
 unsigned long attributionDelay = 20000;
 
+// The weather description, under the temperature; scrolls if it's too long to fit
+Marquee descriptionMarquee(0, 23, 64, 5, 1);
+
 // WMO Weather interpretation codes
 // Adapted from https://open-meteo.com/en/docs (scroll to bottom of page)
 const char *getWeatherDescription(uint16_t weatherId) {
@@ -379,28 +444,298 @@ const char *getWeatherDescription(uint16_t weatherId) {
 	return "";
 }
 
-JsonDocument httpGETRequest(const char *serverName) {
+// Sends a GET request, made conditional if validators from a previous response are available
+// Returns the HTTP status code; on a 200, doc is filled in from the response and validators are updated from its headers
+int httpGETRequest(const char *serverName, const JsonDocument &filter, JsonDocument &doc, uint16_t timeout, ResponseValidators &validators) {
 	WiFiClient client;
 	HTTPClient http;
 
+	// HTTP/1.0 guarantees a plain (non-chunked) body, so the JSON can be parsed straight from the stream
 	http.useHTTP10(true);
+	http.setConnectTimeout(timeout);
+	http.setTimeout(timeout);
 	http.begin(client, serverName);
 
+	const char *headerKeys[] = {"ETag", "Last-Modified", "Cache-Control"};
+	http.collectHeaders(headerKeys, 3);
+
+	if (strlen(validators.etag) > 0) {
+		http.addHeader("If-None-Match", validators.etag);
+	}
+
+	if (strlen(validators.lastModified) > 0) {
+		http.addHeader("If-Modified-Since", validators.lastModified);
+	}
+
 	int httpResponseCode = http.GET();
 
 	Serial.print("HTTP Response code: ");
 	Serial.println(httpResponseCode);
 
+	if (httpResponseCode == 200 || httpResponseCode == 304) {
+		// A 304 may come with updated validators too
+		if (http.hasHeader("ETag")) {
+			strlcpy(validators.etag, http.header("ETag").c_str(), sizeof(validators.etag));
+		}
+
+		if (http.hasHeader("Last-Modified")) {
+			strlcpy(validators.lastModified, http.header("Last-Modified").c_str(), sizeof(validators.lastModified));
+		}
+
+		validators.maxAge = 0;
+		String cacheControl = http.header("Cache-Control");
+		int maxAgeIndex = cacheControl.indexOf("max-age=");
+
+		if (maxAgeIndex >= 0) {
+			validators.maxAge = strtoul(cacheControl.c_str() + maxAgeIndex + 8, nullptr, 10);
+		}
+	}
+
 	if (httpResponseCode == 200) {
-		isOnline = true;
+		// Only the fields present in the filter are kept; the rest of the response is skipped as it streams in
+		DeserializationError deserializationError = deserializeJson(doc, http.getStream(), DeserializationOption::Filter(filter));
+
+		if (deserializationError) {
+			httpResponseCode = HTTPC_ERROR_CONNECTION_LOST;
+		}
+	}
+
+	http.end();
+	return httpResponseCode;
+}
+
+// Builds the filter that picks the handful of Open-Meteo fields shown on screen out of the full forecast response
+JsonDocument openMeteoFilter() {
+	JsonDocument filter;
+
+	filter["current"]["temperature_2m"] = true;
+	filter["current"]["relative_humidity_2m"] = true;
+	filter["current"]["surface_pressure"] = true;
+	filter["current"]["wind_speed_10m"] = true;
+	filter["current"]["weather_code"] = true;
+
+	// A filter array applies its first element to every element of the array
+	filter["hourly"]["time"][0] = true;
+	filter["hourly"]["temperature_2m"][0] = true;
+	filter["hourly"]["relative_humidity_2m"][0] = true;
+	filter["hourly"]["surface_pressure"][0] = true;
+	filter["hourly"]["wind_speed_10m"][0] = true;
+	filter["hourly"]["weather_code"][0] = true;
+	filter["hourly"]["precipitation_probability"][0] = true;
+
+	return filter;
+}
+
+// Fill in the cache from a (filtered) Open-Meteo response
+void importWeatherResponse(const JsonDocument &doc, time_t now) {
+	JsonObjectConst current = doc["current"];
+	JsonObjectConst hourly = doc["hourly"];
+
+	weatherCache.current.temperature = current["temperature_2m"].as<float>();
+	weatherCache.current.humidity = current["relative_humidity_2m"].as<uint8_t>();
+	weatherCache.current.pressure = current["surface_pressure"].as<uint16_t>();
+	weatherCache.current.windSpeed = current["wind_speed_10m"].as<float>();
+	weatherCache.current.pop = hourly["precipitation_probability"][0].as<uint8_t>();
+	weatherCache.current.weatherCode = current["weather_code"].as<uint16_t>();
+
+	weatherCache.firstHour = hourly["time"][0].as<time_t>();
+	weatherCache.hours = 0;
+
+	for (uint8_t i = 0; i < FORECAST_HOURS && !hourly["time"][i].isNull(); i++) {
+		weatherCache.hourly[i].temperature = hourly["temperature_2m"][i].as<float>();
+		weatherCache.hourly[i].humidity = hourly["relative_humidity_2m"][i].as<uint8_t>();
+		weatherCache.hourly[i].pressure = hourly["surface_pressure"][i].as<uint16_t>();
+		weatherCache.hourly[i].windSpeed = hourly["wind_speed_10m"][i].as<float>();
+		weatherCache.hourly[i].pop = hourly["precipitation_probability"][i].as<uint8_t>();
+		weatherCache.hourly[i].weatherCode = hourly["weather_code"][i].as<uint16_t>();
+		weatherCache.hours++;
+	}
+
+	weatherCache.fetchedAt = now;
+	weatherCache.isValid = true;
+}
+
+// How long a response can be used before revalidating it; Open-Meteo's own Cache-Control wins if it sent one
+void setWeatherCacheExpiry(time_t now) {
+	unsigned long freshFor = weatherCache.validators.maxAge > 0 ? weatherCache.validators.maxAge : weatherStationConfig.refreshInterval / 1000;
+	weatherCache.expiresAt = now + freshFor;
+}
+
+void saveWeatherCache() {
+	// Create the "cache" directory if it doesn't exist
+	if (!SD.exists("/cache") && !SD.mkdir("/cache")) {
+		Serial.println("Failed to create directory for the weather cache");
+		return;
+	}
+
+	File weatherCacheFile = SD.open(weatherCacheFilename, FILE_WRITE, true);
+
+	if (!weatherCacheFile) {
+		Serial.println("Failed to open the weather cache for writing");
+		return;
+	}
+
+	JsonDocument jsonDoc;
+
+	// The URL is the cache key; it changes whenever the location (or anything else about the request) does
+	jsonDoc["url"] = serverPath;
+	jsonDoc["etag"] = weatherCache.validators.etag;
+	jsonDoc["lastModified"] = weatherCache.validators.lastModified;
+	jsonDoc["maxAge"] = weatherCache.validators.maxAge;
+	jsonDoc["fetchedAt"] = weatherCache.fetchedAt;
+	jsonDoc["expiresAt"] = weatherCache.expiresAt;
+	jsonDoc["firstHour"] = weatherCache.firstHour;
+
+	JsonArray conditions = jsonDoc["conditions"].to<JsonArray>();
+
+	// The current conditions go first, followed by the hourly forecast
+	for (int8_t i = -1; i < weatherCache.hours; i++) {
+		const WeatherConditions &entry = i < 0 ? weatherCache.current : weatherCache.hourly[i];
+
+		JsonArray row = conditions.add<JsonArray>();
+		row.add(entry.temperature);
+		row.add(entry.humidity);
+		row.add(entry.pressure);
+		row.add(entry.windSpeed);
+		row.add(entry.pop);
+		row.add(entry.weatherCode);
+	}
+
+	if (serializeJson(jsonDoc, weatherCacheFile) == 0) {
+		Serial.println("Failed to write the weather cache");
+	}
+
+	weatherCacheFile.close();
+}
+
+// The cache is only a convenience, so any problem with it just means starting without one
+void loadWeatherCache() {
+	weatherCache = WeatherCache();
+
+	File weatherCacheFile = SD.open(weatherCacheFilename, FILE_READ);
+
+	if (!weatherCacheFile) {
+		return;
+	}
+
+	JsonDocument jsonDoc;
+	DeserializationError deserializationError = deserializeJson(jsonDoc, weatherCacheFile);
+	weatherCacheFile.close();
+
+	if (deserializationError || serverPath != jsonDoc["url"].as<const char *>() || !jsonDoc["conditions"].is<JsonArrayConst>()) {
+		return;
+	}
+
+	strlcpy(weatherCache.validators.etag, jsonDoc["etag"] | "", sizeof(weatherCache.validators.etag));
+	strlcpy(weatherCache.validators.lastModified, jsonDoc["lastModified"] | "", sizeof(weatherCache.validators.lastModified));
+	weatherCache.validators.maxAge = jsonDoc["maxAge"].as<unsigned long>();
+	weatherCache.fetchedAt = jsonDoc["fetchedAt"].as<time_t>();
+	weatherCache.expiresAt = jsonDoc["expiresAt"].as<time_t>();
+	weatherCache.firstHour = jsonDoc["firstHour"].as<time_t>();
+
+	JsonArrayConst conditions = jsonDoc["conditions"];
+
+	if (conditions.size() < 1 || conditions.size() > FORECAST_HOURS + 1) {
+		return;
+	}
+
+	weatherCache.hours = conditions.size() - 1;
+
+	for (uint8_t i = 0; i < conditions.size(); i++) {
+		WeatherConditions &entry = i == 0 ? weatherCache.current : weatherCache.hourly[i - 1];
+		JsonArrayConst row = conditions[i];
+
+		entry.temperature = row[0].as<float>();
+		entry.humidity = row[1].as<uint8_t>();
+		entry.pressure = row[2].as<uint16_t>();
+		entry.windSpeed = row[3].as<float>();
+		entry.pop = row[4].as<uint8_t>();
+		entry.weatherCode = row[5].as<uint16_t>();
+	}
+
+	weatherCache.isValid = true;
+}
+
+// Answer from the cache: the current conditions if they're recent enough, otherwise the forecast for this hour
+// Returns false if the cache doesn't cover the given time
+bool weatherFromCache(time_t now, WeatherData &data) {
+	if (!weatherCache.isValid || now < weatherCache.fetchedAt) {
+		return false;
+	}
+
+	const WeatherConditions *conditions;
+
+	if (now - weatherCache.fetchedAt < CURRENT_CONDITIONS_LIFETIME) {
+		conditions = &weatherCache.current;
 	} else {
-		isOnline = false;
+		long hourIndex = (now - weatherCache.firstHour) / 3600;
+
+		if (now < weatherCache.firstHour || hourIndex >= weatherCache.hours) {
+			return false;
+		}
+
+		conditions = &weatherCache.hourly[hourIndex];
+	}
+
+	// Round temperature to the nearest whole number, instead of just cutting off the decimals
+	data.temp = (int)round(globalConfig.isCelcius ? conditions->temperature : ((conditions->temperature * 9.0 / 5.0) + 32));
+	data.hum = conditions->humidity;
+	data.press = conditions->pressure;
+	data.windSpeed = conditions->windSpeed;
+	data.pop = conditions->pop;
+	data.weatherCode = conditions->weatherCode;
+	data.isOnline = true;
+
+	return true;
+}
+
+// Fetch job that keeps the weather conditions up to date; runs on the data fetcher task
+// Open-Meteo is only asked once the cached response has expired, and then with a conditional GET
+FetchResult fetchWeather(uint16_t timeout) {
+	WeatherData &data = fetchedWeatherData;
+	time_t now = currentUnixTime;
+
+	// The cached response is still fresh, so there's no need to go over the network at all
+	if (weatherCache.isValid && now < weatherCache.expiresAt && weatherFromCache(now, data)) {
+		hasWeatherData = true;
+		weatherSlot.publish(data);
+		return FETCH_OK;
 	}
 
 	JsonDocument doc;
-	deserializeJson(doc, http.getStream());
-	http.end();
-	return doc;
+	int httpResponseCode = httpGETRequest(serverPath.c_str(), openMeteoFilter(), doc, timeout, weatherCache.validators);
+
+	if (httpResponseCode == 200) {
+		importWeatherResponse(doc, now);
+	}
+
+	if (httpResponseCode == 200 || httpResponseCode == 304) {
+		setWeatherCacheExpiry(now);
+		saveWeatherCache();
+
+		if (weatherFromCache(now, data)) {
+			hasWeatherData = true;
+			weatherSlot.publish(data);
+			return FETCH_OK;
+		}
+
+		// A 304 for a cache that no longer covers the current hour; drop the validators so the next attempt fetches in full
+		weatherCache.isValid = false;
+		weatherCache.validators = ResponseValidators();
+		return FETCH_RETRY;
+	}
+
+	// Offline or Open-Meteo is having trouble; the forecast window may still cover the current hour
+	if (weatherFromCache(now, data)) {
+		hasWeatherData = true;
+		weatherSlot.publish(data);
+	} else if (!hasWeatherData) {
+		// Keep showing the last conditions while the fetcher retries; if there aren't any yet, fall back to the indoor readings
+		data.isOnline = false;
+		weatherSlot.publish(data);
+	}
+
+	return FETCH_RETRY;
 }
 
 ///////////////////
@@ -414,12 +749,41 @@ void setup() {
 	configIsLoaded = true;
 
 	dma_display->setFont(&TomThumb);
-	isOnline = !wifiConfig.isAccessPoint && !weatherStationConfig.insideOnly;
+
+	// Line the weather description up with the rest of the left-hand column
+	descriptionMarquee.setCentred(false);
+
+	// Show the indoor readings until the first response from Open-Meteo comes in
+	isOnline = false;
 
 	String lat = weatherStationConfig.latitude;
 	String lon = weatherStationConfig.longitude;
-	serverPath = "http://api.open-meteo.com/v1/forecast?latitude=" + lat + "&longitude=" + lon + "&current=" + "temperature_2m,relative_humidity_2m,surface_pressure,wind_speed_10m,is_day,weather_code" + "&hourly=" + "precipitation_probability" + "&timezone=" + globalConfig.humanReadableTimezone + "&forecast_days=1";
+	serverPath = "http://api.open-meteo.com/v1/forecast?latitude=" + lat + "&longitude=" + lon + "&current=" + "temperature_2m,relative_humidity_2m,surface_pressure,wind_speed_10m,is_day,weather_code" + "&hourly=" + "temperature_2m,relative_humidity_2m,surface_pressure,wind_speed_10m,weather_code,precipitation_probability" + "&timezone=" + globalConfig.humanReadableTimezone + "&forecast_hours=" + FORECAST_HOURS + "&timeformat=unixtime";
 	lastAttributionTime = millis();
+
+	currentUnixTime = rtc.now().unixtime();
+
+	// Open-Meteo is queried in the background, so the clock keeps ticking during a refresh
+	if (!wifiConfig.isAccessPoint && !weatherStationConfig.insideOnly) {
+		weatherJob.name = "weather";
+		weatherJob.run = fetchWeather;
+		weatherJob.interval = weatherStationConfig.refreshInterval;
+		weatherJob.timeout = 5000;
+		weatherJob.maxRetries = 3;
+		weatherJob.retryDelay = 5000;
+		weatherJob.maxRetryDelay = 60000;
+
+		// Show the cached weather straight away after a reboot, while the fetcher gets going
+		loadWeatherCache();
+
+		if (weatherFromCache(currentUnixTime, fetchedWeatherData)) {
+			hasWeatherData = true;
+			weatherSlot.publish(fetchedWeatherData);
+		}
+
+		addFetchJob(&weatherJob);
+		startDataFetcher();
+	}
 }
 
 ///////////////////
@@ -434,6 +798,7 @@ void loop() {
 
 	DateTime rtcTime = rtc.now();
 	time_t utcTimestamp = rtcTime.unixtime();
+	currentUnixTime = utcTimestamp;
 
 	struct tm tmNow;
 	localtime_r(&utcTimestamp, &tmNow);
@@ -442,7 +807,7 @@ void loop() {
 
 	// Skip updating if the time hasn't changed
 	if (now.hour == lastHour && now.minute == lastMinute && now.second == lastSecond) {
-		delay(150);
+		delayWithMarquees(150);
 		return;
 	}
 
@@ -467,25 +832,24 @@ void loop() {
 		}
 	}
 
-	// Send an HTTP GET request to OpenMeteo for the latest weather conditions
-	if (!wifiConfig.isAccessPoint && !weatherStationConfig.insideOnly && (lastTime == 0 || ((millis() - lastTime) > weatherStationConfig.refreshInterval && weatherStationConfig.refreshInterval >= 60000))) {
-		JsonDocument doc = httpGETRequest(serverPath.c_str());
-
-		// Round temperature to the nearest whole number, instead of just cutting off the decimals
-		String tempString = doc["current"]["temperature_2m"];
+	// Pick up the latest weather conditions, if the fetcher has published any since the last loop
+	WeatherData weatherData;
 
-		temp = (int)round(globalConfig.isCelcius ? tempString.toFloat() : ((tempString.toFloat() * 9.0 / 5.0) + 32));
-		hum = doc["current"]["relative_humidity_2m"].as<int>();
-		press = doc["current"]["surface_pressure"].as<int>();
-		wind_speed = doc["current"]["wind_speed_10m"].as<float>();
-		pop = doc["hourly"]["precipitation_probability"][0].as<int>();
-		weather_code = doc["current"]["weather_code"].as<uint16_t>();
+	if (weatherSlot.consume(weatherData, weatherDataVersion)) {
+		isOnline = weatherData.isOnline;
 
-		lastTime = millis();
+		if (isOnline) {
+			temp = weatherData.temp;
+			hum = weatherData.hum;
+			press = weatherData.press;
+			wind_speed = weatherData.windSpeed;
+			pop = weatherData.pop;
+			weather_code = weatherData.weatherCode;
 
-		// Display the weather data attribution (will be shown for 20s after every API request)
-		showDataAttribution = true;
-		lastAttributionTime = millis();
+			// Display the weather data attribution (will be shown for 20s after every API request)
+			showDataAttribution = true;
+			lastAttributionTime = millis();
+		}
 	}
 
 	// If an OTA update is in progress, skip this iteration of the loop
@@ -500,9 +864,9 @@ void loop() {
 	dma_display->setFont(&TomThumb);
 	dma_display->setTextSize(1);
 	dma_display->setCursor(36, 6);
-	dma_display->print(timeBuffer);
+	printText(timeBuffer);
 	dma_display->setCursor(dma_display->getCursorX() + 1, dma_display->getCursorY());
-	dma_display->print(ampm);
+	printText(ampm);
 
 	// Display date
 	if (now.day != lastDay) {
@@ -511,15 +875,15 @@ void loop() {
 
 		dma_display->setCursor(34, 12);
 		sprintf(dateBuffer, "%02d", now.month);
-		dma_display->print(dateBuffer);
+		printText(dateBuffer);
 		dma_display->drawPixel(dma_display->getCursorX(), dma_display->getCursorY() - 3, dma_display->color565(64, 184, 163));
 		dma_display->setCursor(dma_display->getCursorX() + 2, dma_display->getCursorY());
 		sprintf(dateBuffer, "%02d", now.day);
-		dma_display->print(dateBuffer);
+		printText(dateBuffer);
 		dma_display->drawPixel(dma_display->getCursorX(), dma_display->getCursorY() - 3, dma_display->color565(64, 184, 163));
 		dma_display->setCursor(dma_display->getCursorX() + 2, dma_display->getCursorY());
 		sprintf(dateBuffer, "%02d", now.year % 100);
-		dma_display->print(dateBuffer);
+		printText(dateBuffer);
 		lastDay = now.day;
 	}
 
@@ -573,10 +937,11 @@ void loop() {
 	dma_display->setTextColor(dma_display->color565(255, 255, 255));
 
 	if (isOnline && weather_code != lastWeatherCode && !showDataAttribution) {
-		dma_display->fillRect(0, 18, 64, 5, 0);
-		dma_display->print(String(getWeatherDescription(weather_code)));
+		descriptionMarquee.setText(getWeatherDescription(weather_code), &TomThumb, dma_display->color565(255, 255, 255));
 		lastWeatherCode = weather_code;
 	} else if (showDataAttribution) {
+		descriptionMarquee.stop();
+
 		// Go back to showing the weather description after showing the data attribution for 20s
 		if ((millis() - lastAttributionTime) > attributionDelay) {
 			showDataAttribution = false;
@@ -586,10 +951,11 @@ void loop() {
 		dma_display->setCursor(0, 23);
 		dma_display->setTextColor(dma_display->color565(174, 204, 252));
 		dma_display->fillRect(0, 18, 64, 5, 0);
-		dma_display->print("OPEN-METEO.COM :)");
+		printText("OPEN-METEO.COM :)");
 		lastWeatherCode = 999;
 	} else if (!isOnline) {
-		dma_display->print("INSIDE");
+		descriptionMarquee.stop();
+		printText("INSIDE");
 		lastWeatherCode = 0;
 	}
 
@@ -603,7 +969,7 @@ void loop() {
 	if (isOnline) {
 		dma_display->print(hum);
 	} else {
-		dma_display->print("HUM ");
+		printText("HUM ");
 		dma_display->print((int)humidity);
 	}
 
@@ -617,7 +983,7 @@ void loop() {
 	} else {
 		dma_display->setCursor(dma_display->getCursorX() + 5, 31);
 		dma_display->print(pressure / 1000);
-		dma_display->print(" KPA");
+		printText(" KPA");
 	}
 
 	// Display wind speed
@@ -625,7 +991,7 @@ void loop() {
 	dma_display->setTextColor(dma_display->color565(100, 100, 255));
 
 	if (isOnline) {
-		dma_display->print(String(wind_speed, 1));
+		printText(String(wind_speed, 1));
 	}
 
 	// Display POP
@@ -637,7 +1003,7 @@ void loop() {
 		dma_display->print('%');
 	}
 
-	delay(250);
+	delayWithMarquees(250);
 }
 
 #endif
\ No newline at end of file
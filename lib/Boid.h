@@ -45,6 +45,7 @@
 #include "luxigrid.h"
 #include "Vector.h"
 
+// A single steering agent; groups of them (flocking and so on) are handled by the particle system in particles.hpp
 class Boid {
 	public:
 	PVector location;
@@ -80,11 +81,6 @@ class Boid {
 		return (x - in_min) * (out_max - out_min) / (in_max - in_min) + out_min;
 	}
 
-	void run(Boid boids[], uint8_t boidCount) {
-		flock(boids, boidCount);
-		update();
-	}
-
 	// Update location
 	void update() {
 		// Update velocity
@@ -106,14 +102,14 @@ class Boid {
 		// Calculate future position for more effective behaviour
 		PVector futPos = location + velocity;
 		PVector dist = obstacle - futPos;
-		float d = dist.mag();
+		float dSq = dist.magSq();
 
-		if (d <= radius) {
+		if (dSq <= radius * radius) {
 			PVector repelVec = location - obstacle;
 			repelVec.normalize();
 
 			// Don't divide by zero
-			if (d != 0) {
+			if (dSq != 0) {
 				// float scale = 1.0 / d; //The closer to the obstacle, the stronger the force.
 				repelVec.normalize();
 				repelVec *= (maxforce * 7);
@@ -127,131 +123,6 @@ class Boid {
 		}
 	}
 
-	// We accumulate a new acceleration each time based on three rules
-	// Seperation, Alignment, and Cohesion
-	void flock(Boid boids[], uint8_t boidCount) {
-		PVector sep = separate(boids, boidCount);
-		PVector ali = align(boids, boidCount);
-		PVector coh = cohesion(boids, boidCount);
-
-		// Arbitrarily weight these forces
-		sep *= 1.5;
-		ali *= 1.0;
-		coh *= 1.0;
-
-		// Add the force vectors to acceleration
-		applyForce(sep);
-		applyForce(ali);
-		applyForce(coh);
-	}
-
-	// Check for nearby boids and steer away
-	PVector separate(Boid boids[], uint8_t boidCount) {
-		PVector steer = PVector(0, 0);
-		int count = 0;
-
-		// For every boid in the system, check if it's too close
-		for (int i = 0; i < boidCount; i++) {
-			Boid other = boids[i];
-
-			if (!other.enabled) {
-				continue;
-			}
-
-			float d = location.dist(other.location);
-
-			// If the distance is greater than 0 and less than an arbitrary amount (0 when you are yourself)
-			if ((d > 0) && (d < desiredseparation)) {
-				// Calculate vector pointing away from neighbor
-				PVector diff = location - other.location;
-				diff.normalize();
-				// Weight by distance
-				diff /= d;
-				steer += diff;
-				// Keep track of how many
-				count++;
-			}
-		}
-
-		// Average -- divide by how many
-		if (count > 0) {
-			steer /= (float)count;
-		}
-
-		// As long as the vector is greater than 0
-		if (steer.mag() > 0) {
-			// Implement Reynolds: Steering = Desired - Velocity
-			steer.normalize();
-			steer *= maxspeed;
-			steer -= velocity;
-			steer.limit(maxforce);
-		}
-
-		return steer;
-	}
-
-	// For every nearby boid in the system, calculate the average velocity
-	PVector align(Boid boids[], uint8_t boidCount) {
-		PVector sum = PVector(0, 0);
-		int count = 0;
-
-		for (int i = 0; i < boidCount; i++) {
-			Boid other = boids[i];
-
-			if (!other.enabled) {
-				continue;
-			}
-
-			float d = location.dist(other.location);
-
-			if ((d > 0) && (d < neighbordist)) {
-				sum += other.velocity;
-				count++;
-			}
-		}
-
-		if (count > 0) {
-			sum /= (float)count;
-			sum.normalize();
-			sum *= maxspeed;
-			PVector steer = sum - velocity;
-			steer.limit(maxforce);
-			return steer;
-		} else {
-			return PVector(0, 0);
-		}
-	}
-
-	// For the average location (i.e. center) of all nearby boids, calculate steering vector towards that location
-	PVector cohesion(Boid boids[], uint8_t boidCount) {
-		// Start with empty vector to accumulate all locations
-		PVector sum = PVector(0, 0);
-		int count = 0;
-
-		for (int i = 0; i < boidCount; i++) {
-			Boid other = boids[i];
-
-			if (!other.enabled) {
-				continue;
-			}
-
-			float d = location.dist(other.location);
-
-			if ((d > 0) && (d < neighbordist)) {
-				sum += other.location;
-				count++;
-			}
-		}
-
-		if (count > 0) {
-			sum /= count;
-			// Steer towards the location
-			return seek(sum);
-		} else {
-			return PVector(0, 0);
-		}
-	}
-
 	// Calculate and apply a steering force towards a target
 	// STEER = DESIRED MINUS VELOCITY
 	PVector seek(PVector target) {
@@ -33,147 +33,230 @@
 #ifndef Vector_GUARD
 #define Vector_GUARD
 
+// Fast approx 1/sqrt(x), for x > 0
+// The bit trick gets within a few percent, and one Newton-Raphson step takes that down to under 0.2%, which can't be seen on the panel
+inline float fastInverseSqrt(float n) {
+	uint32_t i;
+	float y;
+
+	memcpy(&i, &n, sizeof(i));
+	i = 0x5f375a86 - (i >> 1);
+	memcpy(&y, &i, sizeof(y));
+
+	return y * (1.5f - 0.5f * n * y * y);
+}
+
+// Everything here works in T (i.e. float for PVector), rather than promoting to double, which the ESP32 has to do in software
+// Comparisons against a length should use magSq()/distSq() and compare against the length squared, which avoids the sqrt altogether
 template <class T>
 class Vector2 {
 	public:
 	T x, y;
 
-	Vector2() : x(0), y(0) {}
-	Vector2(T x, T y) : x(x), y(y) {}
-	Vector2(const Vector2& v) : x(v.x), y(v.y) {}
+	constexpr Vector2() : x(0), y(0) {}
+	constexpr Vector2(T x, T y) : x(x), y(y) {}
+	constexpr Vector2(const Vector2& v) : x(v.x), y(v.y) {}
 
-	Vector2& operator=(const Vector2& v) {
+	constexpr Vector2& operator=(const Vector2& v) {
 		x = v.x;
 		y = v.y;
 		return *this;
 	}
 
-	bool isEmpty() {
+	constexpr bool isEmpty() const {
 		return x == 0 && y == 0;
 	}
 
-	bool operator==(Vector2& v) {
+	constexpr bool operator==(const Vector2& v) const {
 		return x == v.x && y == v.y;
 	}
 
-	bool operator!=(Vector2& v) {
-		return !(x == y);
+	constexpr bool operator!=(const Vector2& v) const {
+		return !(*this == v);
 	}
 
-	Vector2 operator+(Vector2& v) {
+	constexpr Vector2 operator+(const Vector2& v) const {
 		return Vector2(x + v.x, y + v.y);
 	}
-	Vector2 operator-(Vector2& v) {
+	constexpr Vector2 operator-(const Vector2& v) const {
 		return Vector2(x - v.x, y - v.y);
 	}
 
-	Vector2& operator+=(Vector2& v) {
+	constexpr Vector2& operator+=(const Vector2& v) {
 		x += v.x;
 		y += v.y;
 		return *this;
 	}
-	Vector2& operator-=(Vector2& v) {
+	constexpr Vector2& operator-=(const Vector2& v) {
 		x -= v.x;
 		y -= v.y;
 		return *this;
 	}
 
-	Vector2 operator+(double s) {
+	constexpr Vector2 operator+(T s) const {
 		return Vector2(x + s, y + s);
 	}
-	Vector2 operator-(double s) {
+	constexpr Vector2 operator-(T s) const {
 		return Vector2(x - s, y - s);
 	}
-	Vector2 operator*(double s) {
+	constexpr Vector2 operator*(T s) const {
 		return Vector2(x * s, y * s);
 	}
-	Vector2 operator/(double s) {
+	constexpr Vector2 operator/(T s) const {
 		return Vector2(x / s, y / s);
 	}
 
-	Vector2& operator+=(double s) {
+	constexpr Vector2& operator+=(T s) {
 		x += s;
 		y += s;
 		return *this;
 	}
-	Vector2& operator-=(double s) {
+	constexpr Vector2& operator-=(T s) {
 		x -= s;
 		y -= s;
 		return *this;
 	}
-	Vector2& operator*=(double s) {
+	constexpr Vector2& operator*=(T s) {
 		x *= s;
 		y *= s;
 		return *this;
 	}
-	Vector2& operator/=(double s) {
-		x /= s;
-		y /= s;
+	// One divide and two multiplies, rather than two divides
+	constexpr Vector2& operator/=(T s) {
+		T inverse = 1 / s;
+		x *= inverse;
+		y *= inverse;
 		return *this;
 	}
 
-	void set(T x, T y) {
+	constexpr void set(T x, T y) {
 		this->x = x;
 		this->y = y;
 	}
 
-	void rotate(double deg) {
-		double theta = deg / 180.0 * M_PI;
-		double c = cos(theta);
-		double s = sin(theta);
-		double tx = x * c - y * s;
-		double ty = x * s + y * c;
+	void rotate(T deg) {
+		T theta = deg / 180 * (T)M_PI;
+		T c = cosf(theta);
+		T s = sinf(theta);
+		T tx = x * c - y * s;
+		T ty = x * s + y * c;
 		x = tx;
 		y = ty;
 	}
 
 	Vector2& normalize() {
-		if (length() == 0) return *this;
-		*this *= (1.0 / length());
+		T lengthSq = magSq();
+
+		if (lengthSq == 0) return *this;
+		*this *= fastInverseSqrt(lengthSq);
 		return *this;
 	}
 
-	float dist(Vector2 v) const {
-		Vector2 d(v.x - x, v.y - y);
-		return d.length();
+	float dist(const Vector2& v) const {
+		return sqrtf(distSq(v));
+	}
+	constexpr T distSq(const Vector2& v) const {
+		return (v.x - x) * (v.x - x) + (v.y - y) * (v.y - y);
 	}
 	float length() const {
-		return sqrt(x * x + y * y);
+		return sqrtf(magSq());
 	}
 
 	float mag() const {
 		return length();
 	}
 
-	float magSq() {
+	constexpr T magSq() const {
 		return (x * x + y * y);
 	}
 
-	void truncate(double length) {
-		double angle = atan2f(y, x);
-		x = length * cos(angle);
-		y = length * sin(angle);
+	void truncate(T length) {
+		T angle = atan2f(y, x);
+		x = length * cosf(angle);
+		y = length * sinf(angle);
 	}
 
-	Vector2 ortho() const {
+	constexpr Vector2 ortho() const {
 		return Vector2(y, -x);
 	}
 
-	static float dot(Vector2 v1, Vector2 v2) {
+	static constexpr T dot(const Vector2& v1, const Vector2& v2) {
 		return v1.x * v2.x + v1.y * v2.y;
 	}
-	static float cross(Vector2 v1, Vector2 v2) {
+	static constexpr T cross(const Vector2& v1, const Vector2& v2) {
 		return (v1.x * v2.y) - (v1.y * v2.x);
 	}
 
-	void limit(float max) {
-		if (magSq() > max * max) {
-			normalize();
-			*this *= max;
+	// Only pays for the (inverse) square root when the vector actually needs shortening
+	void limit(T max) {
+		T lengthSq = magSq();
+
+		if (lengthSq > max * max) {
+			*this *= max * fastInverseSqrt(lengthSq);
 		}
 	}
 };
 
 typedef Vector2<float> PVector;
 
+// Q16.16 fixed point vectors, for simulations that want to stay in integer registers
+// Products are widened to 64 bits before shifting back down, so they don't overflow
+class FixedVector {
+	public:
+	static constexpr int FRACTION_BITS = 16;
+	static constexpr int32_t ONE = 1 << FRACTION_BITS;
+
+	int32_t x, y;
+
+	constexpr FixedVector() : x(0), y(0) {}
+	constexpr FixedVector(int32_t x, int32_t y) : x(x), y(y) {}
+
+	static constexpr FixedVector fromPVector(const PVector& v) {
+		return FixedVector(v.x * ONE, v.y * ONE);
+	}
+
+	constexpr PVector toPVector() const {
+		return PVector((float)x / ONE, (float)y / ONE);
+	}
+
+	static constexpr int32_t multiply(int32_t a, int32_t b) {
+		return ((int64_t)a * b) >> FRACTION_BITS;
+	}
+
+	constexpr FixedVector operator+(const FixedVector& v) const {
+		return FixedVector(x + v.x, y + v.y);
+	}
+	constexpr FixedVector operator-(const FixedVector& v) const {
+		return FixedVector(x - v.x, y - v.y);
+	}
+	constexpr FixedVector operator*(int32_t s) const {
+		return FixedVector(multiply(x, s), multiply(y, s));
+	}
+
+	constexpr FixedVector& operator+=(const FixedVector& v) {
+		x += v.x;
+		y += v.y;
+		return *this;
+	}
+	constexpr FixedVector& operator-=(const FixedVector& v) {
+		x -= v.x;
+		y -= v.y;
+		return *this;
+	}
+	constexpr FixedVector& operator*=(int32_t s) {
+		x = multiply(x, s);
+		y = multiply(y, s);
+		return *this;
+	}
+
+	// In Q32.32, so it can be compared against a squared length without losing anything
+	constexpr int64_t magSq() const {
+		return (int64_t)x * x + (int64_t)y * y;
+	}
+
+	constexpr int64_t distSq(const FixedVector& v) const {
+		return (*this - v).magSq();
+	}
+};
+
 #endif
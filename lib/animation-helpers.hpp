@@ -33,8 +33,10 @@
 
 #include "Arduino.h"
 #include <FastLED.h>
+#include <atomic>
 
 #include "luxigrid.h"
+#include "compositor.h"
 
 CRGBPalette16 currentPalette;
 CRGB *leds;
@@ -47,6 +49,84 @@ unsigned long fps_timer;
 const unsigned int default_fps = 30;
 unsigned long last_frame = 0, ms_previous = 0;
 
+// currentPalette expanded to 256 colours, so animations can look colours up directly instead of blending palette entries for every pixel
+// Set palettes with setPalette() (rather than assigning currentPalette), so the cache gets rebuilt
+CRGB paletteCache[256];
+
+// During a crossfade, the cache is rebuilt this many entries per frame, and the fade moves on a step each time it's fully rebuilt
+#define PALETTE_CACHE_BLOCK 64
+
+uint16_t paletteCacheNext = 256;
+CRGBPalette16 paletteFadeFrom, paletteFadeTo;
+uint8_t paletteFadeStep = 0, paletteFadeSteps = 0;
+
+void rebuildPaletteCache(uint16_t start, uint16_t end) {
+	for (uint16_t i = start; i < end; i++) {
+		paletteCache[i] = ColorFromPalette(currentPalette, i);
+	}
+}
+
+void setPalette(const CRGBPalette16 &palette) {
+	currentPalette = palette;
+	paletteFadeSteps = 0;
+	paletteFadeStep = 0;
+
+	rebuildPaletteCache(0, 256);
+	paletteCacheNext = 256;
+}
+
+// Fade from the current palette to another one over the given number of steps (each of which takes 256 / PALETTE_CACHE_BLOCK frames)
+void crossfadePalette(const CRGBPalette16 &palette, uint8_t steps) {
+	paletteFadeFrom = currentPalette;
+	paletteFadeTo = palette;
+	paletteFadeSteps = steps;
+	paletteFadeStep = 0;
+}
+
+// Called once a frame (by updateScreen) to move any crossfade along
+void updatePaletteCache() {
+	if (paletteCacheNext >= 256) {
+		if (paletteFadeStep >= paletteFadeSteps) {
+			return;
+		}
+
+		paletteFadeStep++;
+		blend(paletteFadeFrom.entries, paletteFadeTo.entries, currentPalette.entries, 16, paletteFadeStep * 255 / paletteFadeSteps);
+		paletteCacheNext = 0;
+	}
+
+	uint16_t end = min(paletteCacheNext + PALETTE_CACHE_BLOCK, 256);
+	rebuildPaletteCache(paletteCacheNext, end);
+	paletteCacheNext = end;
+}
+
+// The same as ColorFromPalette(currentPalette, index, brightness), but with the blending already done
+inline CRGB paletteLookup(uint8_t index, uint8_t brightness = 255) {
+	CRGB colour = paletteCache[index];
+
+	if (brightness == 255) {
+		return colour;
+	}
+
+	if (brightness == 0) {
+		return CRGB::Black;
+	}
+
+	// Scale the same way ColorFromPalette does, so the results are identical
+	brightness++;
+
+	for (uint8_t i = 0; i < 3; i++) {
+		if (colour.raw[i]) {
+			colour.raw[i] = scale8(colour.raw[i], brightness);
+#if !(FASTLED_SCALE8_FIXED == 1)
+			colour.raw[i]++;
+#endif
+		}
+	}
+
+	return colour;
+}
+
 uint16_t XY16(uint16_t x, uint16_t y) {
 	if (x >= MATRIX_WIDTH) {
 		return 0;
@@ -60,13 +140,101 @@ uint16_t XY16(uint16_t x, uint16_t y) {
 	return (y * MATRIX_WIDTH) + x + 1;
 }
 
+// leds is the compositor's base, so any layers the app adds (text, notifications, the OTA update box) are drawn over it
+// Only the pixels that have changed since the last frame are sent to the panel
 void updateScreen() {
-	for (int y = 0; y < MATRIX_HEIGHT; ++y) {
-		for (int x = 0; x < MATRIX_WIDTH; ++x) {
-			uint16_t _pixel = XY16(x, y);
-			dma_display->drawPixelRGB888(x, y, leds[_pixel].r, leds[_pixel].g, leds[_pixel].b);
+	// Everything is offset by one in leds (see XY16), so the panel starts at leds[1]
+	compositor.setBase((const uint8_t *)&leds[1]);
+	compositor.markBaseDirty();
+	compositor.present();
+
+	updatePaletteCache();
+}
+
+// Shader-style animations, where every row can be worked out independently, can share the work with core 0 (which is mostly idle)
+// parallelFor(rows, body) calls body(row) once for every row in [0, rows), with rows handed out in small bands to whichever core is free
+// It returns once every row is done, so the result can go straight to updateScreen()
+// The body mustn't touch anything shared between rows (apart from reading), otherwise the output will depend on timing
+#define PARALLEL_BAND_ROWS 2
+
+struct ParallelJob {
+	void (*runBand)(void *body, uint16_t start, uint16_t end);
+	void *body;
+	uint16_t rows;
+	std::atomic<uint16_t> nextRow;
+};
+
+ParallelJob parallelJob;
+TaskHandle_t parallelWorkerTask = NULL;
+TaskHandle_t parallelCallerTask = NULL;
+
+// Keep taking bands until there are none left
+void runParallelBands(ParallelJob &job) {
+	for (;;) {
+		uint16_t start = job.nextRow.fetch_add(PARALLEL_BAND_ROWS);
+
+		if (start >= job.rows) {
+			return;
 		}
+
+		job.runBand(job.body, start, min((uint16_t)(start + PARALLEL_BAND_ROWS), job.rows));
 	}
 }
 
+void runParallelWorker(void *pvParameters) {
+	for (;;) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		runParallelBands(parallelJob);
+		xTaskNotifyGive(parallelCallerTask);
+	}
+}
+
+template <typename Body>
+void runParallelBand(void *body, uint16_t start, uint16_t end) {
+	Body &run = *(Body *)body;
+
+	for (uint16_t row = start; row < end; row++) {
+		run(row);
+	}
+}
+
+template <typename Body>
+void parallelFor(uint16_t rows, Body body) {
+	// The worker is started the first time it's needed, so animations that don't use it don't pay for it
+	if (parallelWorkerTask == NULL) {
+		BaseType_t created = xTaskCreatePinnedToCore(
+		    runParallelWorker,    /* Task function */
+		    "runParallelWorker",  /* Name of the task, for debugging purposes */
+		    4096,                 /* Stack size for the task */
+		    NULL,                 /* Parameter to pass to the task */
+		    1,                    /* Task priority */
+		    &parallelWorkerTask,  /* Task handle */
+		    0                     /* Core where the task should run (the render loop is on core 1) */
+		);
+
+		if (created != pdPASS) {
+			parallelWorkerTask = NULL;
+		}
+	}
+
+	parallelJob.runBand = runParallelBand<Body>;
+	parallelJob.body = &body;
+	parallelJob.rows = rows;
+	parallelJob.nextRow = 0;
+
+	// Without a worker (e.g. there wasn't the memory for its stack), do every band on this core instead
+	if (parallelWorkerTask == NULL) {
+		runParallelBands(parallelJob);
+		return;
+	}
+
+	parallelCallerTask = xTaskGetCurrentTaskHandle();
+
+	xTaskNotifyGive(parallelWorkerTask);
+	runParallelBands(parallelJob);
+
+	// Wait for the worker to finish its last band
+	ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+}
+
 #endif
\ No newline at end of file
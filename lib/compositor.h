@@ -0,0 +1,183 @@
+/* _    _  _ _  _ _ ____ ____ _ ___
+ * |    |  |  \/  | | __ |__/ | |  \
+ * |___ |__| _/\_ | |__] |  \ | |__/
+ * =================================
+ * Luxigrid - Off-Screen Canvases and Layer Compositor
+ * Copyright (c) 2024 OverScore Media - MIT License
+ * ==================================
+ *
+ * MIT LICENSE:
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef COMPOSITOR_GUARD
+#define COMPOSITOR_GUARD
+
+#include "Arduino.h"
+#include "luxigrid.h"
+
+// The compositor flattens a stack of layers into the frame shown on the panel:
+//  - At the bottom is the base, an RGB888 buffer covering the whole panel (e.g. FastLED's leds), or black if there isn't one
+//  - On top of that are up to MAX_LAYERS canvases (e.g. a text overlay, then a notification), each with its own alpha, opacity and blend mode
+// Only the region that has changed since the last frame is flattened, and only the pixels that actually came out different are sent to the panel
+
+#define MAX_LAYERS 4
+
+enum BlendMode {
+	BLEND_NORMAL,    // Alpha blended over the layers below
+	BLEND_ADD,       // Added to the layers below (good for glows)
+	BLEND_MULTIPLY,  // Darkens the layers below (good for shadows and tints)
+	BLEND_SCREEN,    // Lightens the layers below, without clipping as harshly as BLEND_ADD
+};
+
+// A rectangle that grows to cover everything marked in it, in inclusive coordinates
+struct DirtyRect {
+	int16_t x1 = INT16_MAX;
+	int16_t y1 = INT16_MAX;
+	int16_t x2 = INT16_MIN;
+	int16_t y2 = INT16_MIN;
+
+	bool isEmpty() const {
+		return x2 < x1 || y2 < y1;
+	}
+
+	void add(int16_t x, int16_t y, int16_t w, int16_t h) {
+		if (w <= 0 || h <= 0) {
+			return;
+		}
+
+		x1 = min(x1, x);
+		y1 = min(y1, y);
+		x2 = max(x2, (int16_t)(x + w - 1));
+		y2 = max(y2, (int16_t)(y + h - 1));
+	}
+
+	void add(const DirtyRect &other, int16_t offsetX = 0, int16_t offsetY = 0) {
+		if (!other.isEmpty()) {
+			add(other.x1 + offsetX, other.y1 + offsetY, other.x2 - other.x1 + 1, other.y2 - other.y1 + 1);
+		}
+	}
+
+	void clear() {
+		*this = DirtyRect();
+	}
+};
+
+// An off-screen RGB565 canvas with an 8-bit alpha channel, drawn on with the usual Adafruit GFX calls
+// Drawing replaces pixels (colour and alpha) rather than blending into them; blending happens when the layers are composited
+// Everything drawn is added to the canvas' dirty region, so the compositor knows what needs flattening again
+class AlphaCanvas : public Adafruit_GFX {
+	public:
+	AlphaCanvas(uint16_t width, uint16_t height);
+	~AlphaCanvas();
+
+	void drawPixel(int16_t x, int16_t y, uint16_t colour) override;
+	void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t colour) override;
+	void drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t colour) override;
+	void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t colour) override;
+	void fillScreen(uint16_t colour) override;
+
+	// The alpha given to everything drawn from now on (255 is opaque)
+	void setDrawAlpha(uint8_t alpha) {
+		drawAlpha = alpha;
+	}
+
+	// Make the whole canvas, or part of it, fully transparent
+	void clear();
+	void clearRect(int16_t x, int16_t y, int16_t w, int16_t h);
+
+	uint16_t getPixel(int16_t x, int16_t y) const;
+	uint8_t getAlpha(int16_t x, int16_t y) const;
+
+	const DirtyRect &getDirtyRect() const {
+		return dirty;
+	}
+
+	void clearDirtyRect() {
+		dirty.clear();
+	}
+
+	private:
+	// Clips the rectangle to the canvas, fills it, and marks it dirty
+	void fillClipped(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t colour, uint8_t alpha);
+
+	uint16_t *colours;
+	uint8_t *alphas;
+	uint8_t drawAlpha = 255;
+	DirtyRect dirty;
+
+	friend class Compositor;
+};
+
+class Compositor {
+	public:
+	Compositor();
+
+	// Layers are stacked in the order they're added, so the first one added is at the bottom
+	// x and y are where the canvas' top left corner goes on the panel
+	bool addLayer(AlphaCanvas *canvas, int16_t x = 0, int16_t y = 0, BlendMode mode = BLEND_NORMAL, uint8_t opacity = 255);
+	void removeLayer(AlphaCanvas *canvas);
+	void moveLayer(AlphaCanvas *canvas, int16_t x, int16_t y);
+	void setLayerVisible(AlphaCanvas *canvas, bool visible);
+	void setLayerOpacity(AlphaCanvas *canvas, uint8_t opacity);
+
+	// pixels is PANEL_RES_X * PANEL_RES_Y RGB888 triplets, row by row, or NULL for a black base
+	// The compositor only reads the buffer during present(), after whatever part of it has changed has been marked dirty
+	void setBase(const uint8_t *pixels);
+	void markBaseDirty();
+	void markBaseDirty(int16_t x, int16_t y, int16_t w, int16_t h);
+
+	// Call this when something has drawn on the panel without going through the compositor
+	// Until the whole panel has been presented again, every pixel that's flattened gets written, instead of skipping the ones that look unchanged
+	void invalidate();
+
+	// Flatten the dirty region and send any pixels that have changed to the panel
+	void present();
+
+	private:
+	struct Layer {
+		AlphaCanvas *canvas;
+		int16_t x;
+		int16_t y;
+		BlendMode mode;
+		uint8_t opacity;
+		bool visible;
+	};
+
+	Layer *findLayer(AlphaCanvas *canvas);
+	void markLayerDirty(const Layer &layer);
+
+	Layer layers[MAX_LAYERS];
+	uint8_t layerCount = 0;
+
+	const uint8_t *base = NULL;
+
+	// What's on the panel, as far as the compositor knows
+	uint8_t frame[PANEL_RES_X * PANEL_RES_Y * 3];
+	bool frameIsKnown = false;
+
+	// Changes to the base and the layer stack itself (the canvases keep track of their own changes)
+	DirtyRect dirty;
+
+	// present() is called from both the app's loop and the background tasks (for the OTA overlay)
+	SemaphoreHandle_t mutex;
+};
+
+extern Compositor compositor;
+
+#endif
@@ -0,0 +1,274 @@
+/* _    _  _ _  _ _ ____ ____ _ ___
+ * |    |  |  \/  | | __ |__/ | |  \
+ * |___ |__| _/\_ | |__] |  \ | |__/
+ * =================================
+ * Luxigrid - Background Data Fetcher
+ * Copyright (c) 2024 OverScore Media - MIT License
+ * ==================================
+ *
+ * MIT LICENSE:
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef DATA_FETCHER_GUARD
+#define DATA_FETCHER_GUARD
+
+#include "Arduino.h"
+#include "luxigrid.h"
+
+// Network apps register their HTTP requests as fetch jobs, which run on their own task (on the same core as runBackgroundTasks)
+// The app's loop() never blocks on the network; it just picks up whatever data was last published to a DataSlot
+// Each job must own its network objects (HTTPClient, NetworkClient, etc.) exclusively; nothing else may use them, since the
+// fetcher task can be halfway through a request at any time (e.g. the web server validating config has to use its own client)
+
+#define MAX_FETCH_JOBS 4
+
+// How often the fetcher task checks whether any job is due, in milliseconds
+#define FETCHER_POLL_INTERVAL 50
+
+// The outcome of a single run of a fetch job
+enum FetchResult {
+	FETCH_OK,      // Fresh data was published; run again after the job's interval
+	FETCH_RETRY,   // Something transient went wrong (timeout, connection dropped, etc.); retry with exponential backoff
+	FETCH_FAILED,  // Retrying won't help (e.g. an invalid API token); wait for the job's full interval
+};
+
+struct FetchJob {
+	const char *name;
+
+	// Performs the request and publishes the result; timeout is the per-request timeout in milliseconds
+	FetchResult (*run)(uint16_t timeout);
+
+	// Time between successful runs
+	unsigned long interval;
+	uint16_t timeout;
+
+	// Backoff starts at retryDelay and doubles with every consecutive failure, up to maxRetryDelay
+	// After maxRetries consecutive failures, the job gives up until its next regular interval
+	uint8_t maxRetries;
+	unsigned long retryDelay;
+	unsigned long maxRetryDelay;
+
+	// A job can set this during a run to say exactly when it should next run (e.g. from a rate limit response)
+	// It overrides both the interval and the backoff, and is cleared after use
+	unsigned long runAgainIn;
+
+	// Managed by the fetcher
+	unsigned long nextRunTime;
+	uint8_t failures;
+	bool runNow;
+};
+
+// Hands data from the fetcher task to the render loop
+// The fetcher fills the back buffer at its leisure, then swaps it to the front under a lock
+// The render loop copies the front buffer out under the same lock, so it only ever sees a complete result
+template <typename T>
+class DataSlot {
+	public:
+	// Called from the fetcher task
+	void publish(const T &value) {
+		// Only the fetcher ever changes front, so it's safe to read here without the lock
+		uint8_t back = front ^ 1;
+		buffers[back] = value;
+
+		portENTER_CRITICAL(&mux);
+		front = back;
+		version++;
+		portEXIT_CRITICAL(&mux);
+	}
+
+	// Called from the render loop; copies the latest data into out if anything newer than lastVersion has been published
+	bool consume(T &out, uint32_t &lastVersion) {
+		bool updated = false;
+
+		portENTER_CRITICAL(&mux);
+		if (version != lastVersion) {
+			out = buffers[front];
+			lastVersion = version;
+			updated = true;
+		}
+		portEXIT_CRITICAL(&mux);
+
+		return updated;
+	}
+
+	private:
+	T buffers[2];
+	uint8_t front = 0;
+	uint32_t version = 0;
+	portMUX_TYPE mux = portMUX_INITIALIZER_UNLOCKED;
+};
+
+// Keeps requests under an API's rate limit
+// Tokens refill continuously at the given rate, up to capacity; each request takes one
+// A capacity above 1 allows short bursts (e.g. filling in data after startup) without going over the limit on average
+class TokenBucket {
+	public:
+	void begin(float capacity, float tokensPerMinute) {
+		this->capacity = capacity;
+		tokensPerMs = tokensPerMinute / 60000.0;
+		tokens = capacity;
+		lastRefill = millis();
+	}
+
+	bool tryTake() {
+		refill();
+
+		if (tokens < 1) {
+			return false;
+		}
+
+		tokens -= 1;
+		return true;
+	}
+
+	// Milliseconds until the next token is available
+	unsigned long waitTime() {
+		refill();
+
+		if (tokens >= 1) {
+			return 0;
+		}
+
+		return (unsigned long)ceil((1 - tokens) / tokensPerMs);
+	}
+
+	// Used when the API reports that the limit has been hit anyway (e.g. another device sharing the same API key)
+	void empty() {
+		refill();
+		tokens = 0;
+	}
+
+	private:
+	void refill() {
+		unsigned long currentMillis = millis();
+
+		tokens += (currentMillis - lastRefill) * tokensPerMs;
+		lastRefill = currentMillis;
+
+		if (tokens > capacity) {
+			tokens = capacity;
+		}
+	}
+
+	float capacity = 1;
+	float tokens = 1;
+	float tokensPerMs = 0;
+	unsigned long lastRefill = 0;
+};
+
+FetchJob *fetchJobs[MAX_FETCH_JOBS];
+uint8_t fetchJobCount = 0;
+
+TaskHandle_t dataFetcherTask = NULL;
+
+void addFetchJob(FetchJob *job) {
+	if (fetchJobCount >= MAX_FETCH_JOBS) {
+		Serial.println("Too many fetch jobs; ignoring " + String(job->name));
+		return;
+	}
+
+	// Run as soon as the fetcher starts
+	job->nextRunTime = millis();
+	job->runAgainIn = 0;
+	job->failures = 0;
+	job->runNow = true;
+
+	fetchJobs[fetchJobCount++] = job;
+}
+
+// Ask for a job to be run on the next pass of the fetcher, instead of waiting for its interval
+void requestFetch(FetchJob *job) {
+	job->runNow = true;
+}
+
+unsigned long fetchBackoffDelay(const FetchJob *job) {
+	unsigned long backoff = job->retryDelay;
+
+	for (uint8_t i = 1; i < job->failures && backoff < job->maxRetryDelay; i++) {
+		backoff <<= 1;
+	}
+
+	if (backoff > job->maxRetryDelay) {
+		backoff = job->maxRetryDelay;
+	}
+
+	// Add up to 25% jitter, so several jobs don't keep retrying in lockstep
+	return backoff + random(backoff / 4 + 1);
+}
+
+void runFetchJob(FetchJob *job) {
+	job->runNow = false;
+
+	FetchResult result = job->run(job->timeout);
+
+	// Measure from when the job finished, so a slow request doesn't eat into the next interval
+	unsigned long currentMillis = millis();
+
+	if (job->runAgainIn > 0) {
+		job->failures = result == FETCH_OK ? 0 : job->failures;
+		job->nextRunTime = currentMillis + job->runAgainIn;
+		job->runAgainIn = 0;
+	} else if (result == FETCH_OK) {
+		job->failures = 0;
+		job->nextRunTime = currentMillis + job->interval;
+	} else if (result == FETCH_RETRY && job->failures < job->maxRetries) {
+		job->failures++;
+		job->nextRunTime = currentMillis + fetchBackoffDelay(job);
+
+		Serial.printf("Fetch job %s failed; retry %d of %d\n", job->name, job->failures, job->maxRetries);
+	} else {
+		job->failures = 0;
+		job->nextRunTime = currentMillis + job->interval;
+	}
+}
+
+void runDataFetcher(void *pvParameters) {
+	for (;;) {
+		// Stay off the network while an OTA update is being received
+		if (!otaUpdateInProgress) {
+			for (uint8_t i = 0; i < fetchJobCount; i++) {
+				// Signed comparison, so this keeps working when millis() wraps around
+				if (fetchJobs[i]->runNow || (long)(millis() - fetchJobs[i]->nextRunTime) >= 0) {
+					runFetchJob(fetchJobs[i]);
+				}
+			}
+		}
+
+		vTaskDelay(FETCHER_POLL_INTERVAL / portTICK_PERIOD_MS);
+	}
+}
+
+// Start the fetcher task; call this from setup() once all jobs have been added
+void startDataFetcher() {
+	if (dataFetcherTask != NULL || fetchJobCount == 0) {
+		return;
+	}
+
+	xTaskCreatePinnedToCore(
+	    runDataFetcher,    /* Task function */
+	    "runDataFetcher",  /* Name of the task, for debugging purposes */
+	    8192,              /* Stack size for the task; TLS handshakes need a fair bit */
+	    NULL,              /* Parameter to pass to the task */
+	    1,                 /* Task priority */
+	    &dataFetcherTask,  /* Task handle */
+	    0                  /* Core where the task should run (same as runBackgroundTasks, away from the render loop) */
+	);
+}
+
+#endif
@@ -41,27 +41,25 @@ class Digit {
 	void init(byte value, uint16_t xo, uint16_t yo, uint16_t color);
 	void Draw(byte value, uint16_t c);
 	void Morph(byte newValue);
+	bool StepMorph();
+	bool IsMorphing();
 	byte Value();
 	void DrawColon(uint16_t c);
 
 	private:
 	byte _value;
 	uint16_t _color, _bg, xOffset, yOffset;
-	int animSpeed = 30;
-	void drawPixel(uint16_t x, uint16_t y, uint16_t c);
-	void drawFillRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t c);
-	void drawLine(uint16_t x, uint16_t y, uint16_t x2, uint16_t y2, uint16_t c);
+
+	// The morph in progress, if any: an index into the keyframe table, and how many of its steps have been drawn
+	int8_t morphSequence = -1;
+	uint8_t morphStep = 0;
+
+	void drawPixel(int16_t x, int16_t y, uint16_t c);
+	void drawFillRect(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t c);
+	void drawLine(int16_t x, int16_t y, int16_t x2, int16_t y2, uint16_t c);
 	void drawSeg(byte seg);
-	void Morph2();
-	void Morph3();
-	void Morph4();
-	void Morph5();
-	void Morph6();
-	void Morph7();
-	void Morph8();
-	void Morph9();
-	void Morph0();
-	void Morph1();
+	void drawMorphStep(uint16_t step);
+	void finishMorph();
 };
 
 const byte sA = 0;
@@ -111,15 +109,15 @@ byte Digit::Value() {
 	return _value;
 }
 
-void Digit::drawPixel(uint16_t x, uint16_t y, uint16_t c) {
+void Digit::drawPixel(int16_t x, int16_t y, uint16_t c) {
 	dma_display->drawPixel(xOffset + x, height - (y + yOffset), c);
 }
 
-void Digit::drawLine(uint16_t x, uint16_t y, uint16_t x2, uint16_t y2, uint16_t c) {
+void Digit::drawLine(int16_t x, int16_t y, int16_t x2, int16_t y2, uint16_t c) {
 	dma_display->drawLine(xOffset + x, height - (y + yOffset), xOffset + x2, height - (y2 + yOffset), c);
 }
 
-void Digit::drawFillRect(uint16_t x, uint16_t y, uint16_t w, uint16_t h, uint16_t c) {
+void Digit::drawFillRect(int16_t x, int16_t y, uint16_t w, uint16_t h, uint16_t c) {
 	dma_display->fillRect(xOffset + x, height - (y + yOffset), w, h, c);
 }
 
@@ -170,213 +168,363 @@ void Digit::Draw(byte value, uint16_t c) {
 	_value = value;
 }
 
-void Digit::Morph0() {
+///////////////////
+// MORPH KEYFRAMES
+///////////////////
+// Every morph is worked out once, up front, as a list of steps, each of which is a handful of lines to draw or erase
+// A digit then draws one step per frame, so any number of digits can morph at the same time without blocking
+// The morphs are designed around counting up, so there's one for each new value (and several for 0, depending on the old value)
+#define MORPH_STEP_TIME 30
+#define MORPH_SEQUENCES 15
+#define MAX_MORPH_STEPS 128
+#define MAX_MORPH_OPS 512
+
+struct MorphOp {
+	int8_t x1;
+	int8_t y1;
+	int8_t x2;
+	int8_t y2;
+	bool draw;  // false to erase
+};
+
+MorphOp morphOps[MAX_MORPH_OPS];
+uint16_t morphOpCount = 0;
+
+// Step n of the table covers morphOps[morphStepOps[n]] up to (but not including) morphOps[morphStepOps[n + 1]]
+uint16_t morphStepOps[MAX_MORPH_STEPS + 1];
+uint16_t morphStepCount = 0;
+
+uint16_t morphFirstStep[MORPH_SEQUENCES];
+uint8_t morphLength[MORPH_SEQUENCES];
+bool morphTableBuilt = false;
+
+// The old values the morphs to 0 know how to start from
+const byte morphsToZero[] = {1, 2, 3, 5, 9};
+
+void recordLine(int8_t x, int8_t y, int8_t x2, int8_t y2, bool draw) {
+	if (morphOpCount < MAX_MORPH_OPS) {
+		morphOps[morphOpCount++] = {x, y, x2, y2, draw};
+	}
+}
+
+void recordPixel(int8_t x, int8_t y, bool draw) {
+	recordLine(x, y, x, y, draw);
+}
+
+void endMorphStep() {
+	if (morphStepCount < MAX_MORPH_STEPS) {
+		morphStepOps[++morphStepCount] = morphOpCount;
+	}
+}
+
+void buildMorph0(byte from) {
 	for (int i = 0; i <= segWidth; i++) {
 		// If 1 to 0, slide B to F and E to C
-		if (_value == 1) {
+		if (from == 1) {
 			// Slide B to F
-			drawLine(segWidth - i, segHeight * 2 + 1, segWidth - i, segHeight + 2, _color);
-			if (i > 0) drawLine(segWidth - i + 1, segHeight * 2 + 1, segWidth - i + 1, segHeight + 2, _bg);
+			recordLine(segWidth - i, segHeight * 2 + 1, segWidth - i, segHeight + 2, true);
+			if (i > 0) recordLine(segWidth - i + 1, segHeight * 2 + 1, segWidth - i + 1, segHeight + 2, false);
 
 			// Slide E to C
-			drawLine(segWidth - i, 1, segWidth - i, segHeight, _color);
-			if (i > 0) drawLine(segWidth - i + 1, 1, segWidth - i + 1, segHeight, _bg);
+			recordLine(segWidth - i, 1, segWidth - i, segHeight, true);
+			if (i > 0) recordLine(segWidth - i + 1, 1, segWidth - i + 1, segHeight, false);
 
-			if (i < segWidth) drawPixel(segWidth - i, segHeight * 2 + 2, _color);  // Draw A
-			if (i < segWidth) drawPixel(segWidth - i, 0, _color);                  // Draw D
+			if (i < segWidth) recordPixel(segWidth - i, segHeight * 2 + 2, true);  // Draw A
+			if (i < segWidth) recordPixel(segWidth - i, 0, true);                  // Draw D
 		}
 
 		// If 2 to 0, slide B to F and Flow G to C
-		if (_value == 2) {
+		if (from == 2) {
 			// Slide B to F
-			drawLine(segWidth - i, segHeight * 2 + 1, segWidth - i, segHeight + 2, _color);
-			if (i > 0) drawLine(segWidth - i + 1, segHeight * 2 + 1, segWidth - i + 1, segHeight + 2, _bg);
+			recordLine(segWidth - i, segHeight * 2 + 1, segWidth - i, segHeight + 2, true);
+			if (i > 0) recordLine(segWidth - i + 1, segHeight * 2 + 1, segWidth - i + 1, segHeight + 2, false);
 
-			drawPixel(1 + i, segHeight + 1, _bg);                                  // Erase G left to right
-			if (i < segWidth) drawPixel(segWidth + 1, segHeight + 1 - i, _color);  // Draw C
+			recordPixel(1 + i, segHeight + 1, false);                                  // Erase G left to right
+			if (i < segWidth) recordPixel(segWidth + 1, segHeight + 1 - i, true);  // Draw C
 		}
 
 		// B to F, C to E
-		if (_value == 3) {
+		if (from == 3) {
 			// Slide B to F
-			drawLine(segWidth - i, segHeight * 2 + 1, segWidth - i, segHeight + 2, _color);
-			if (i > 0) drawLine(segWidth - i + 1, segHeight * 2 + 1, segWidth - i + 1, segHeight + 2, _bg);
+			recordLine(segWidth - i, segHeight * 2 + 1, segWidth - i, segHeight + 2, true);
+			if (i > 0) recordLine(segWidth - i + 1, segHeight * 2 + 1, segWidth - i + 1, segHeight + 2, false);
 
 			// Move C to E
-			drawLine(segWidth - i, 1, segWidth - i, segHeight, _color);
-			if (i > 0) drawLine(segWidth - i + 1, 1, segWidth - i + 1, segHeight, _bg);
+			recordLine(segWidth - i, 1, segWidth - i, segHeight, true);
+			if (i > 0) recordLine(segWidth - i + 1, 1, segWidth - i + 1, segHeight, false);
 
 			// Erase G from right to left
-			drawPixel(segWidth - i, segHeight + 1, _bg);  // G
+			recordPixel(segWidth - i, segHeight + 1, false);  // G
 		}
 
 		// If 5 to 0, we also need to slide F to B
-		if (_value == 5) {
+		if (from == 5) {
 			if (i < segWidth) {
-				if (i > 0) drawLine(1 + i, segHeight * 2 + 1, 1 + i, segHeight + 2, _bg);
-				drawLine(2 + i, segHeight * 2 + 1, 2 + i, segHeight + 2, _color);
+				if (i > 0) recordLine(1 + i, segHeight * 2 + 1, 1 + i, segHeight + 2, false);
+				recordLine(2 + i, segHeight * 2 + 1, 2 + i, segHeight + 2, true);
 			}
 		}
 
 		// If 9 or 5 to 0, Flow G into E
-		if (_value == 5 || _value == 9) {
-			if (i < segWidth) drawPixel(segWidth - i, segHeight + 1, _bg);
-			if (i < segWidth) drawPixel(0, segHeight - i, _color);
+		if (from == 5 || from == 9) {
+			if (i < segWidth) recordPixel(segWidth - i, segHeight + 1, false);
+			if (i < segWidth) recordPixel(0, segHeight - i, true);
 		}
 
-		delay(animSpeed);
+		endMorphStep();
 	}
 }
 
 // Zero or two to one
-void Digit::Morph1() {
+void buildMorph1() {
 	for (int i = 0; i <= (segWidth + 1); i++) {
 		// Move E left to right
-		drawLine(0 + i - 1, 1, 0 + i - 1, segHeight, _bg);
-		drawLine(0 + i, 1, 0 + i, segHeight, _color);
+		recordLine(0 + i - 1, 1, 0 + i - 1, segHeight, false);
+		recordLine(0 + i, 1, 0 + i, segHeight, true);
 
 		// Move F left to right
-		drawLine(0 + i - 1, segHeight * 2 + 1, 0 + i - 1, segHeight + 2, _bg);
-		drawLine(0 + i, segHeight * 2 + 1, 0 + i, segHeight + 2, _color);
+		recordLine(0 + i - 1, segHeight * 2 + 1, 0 + i - 1, segHeight + 2, false);
+		recordLine(0 + i, segHeight * 2 + 1, 0 + i, segHeight + 2, true);
 
 		// Gradually Erase A, G, D
-		drawPixel(1 + i, segHeight * 2 + 2, _bg);  // A
-		drawPixel(1 + i, 0, _bg);                  // D
-		drawPixel(1 + i, segHeight + 1, _bg);      // G
+		recordPixel(1 + i, segHeight * 2 + 2, false);  // A
+		recordPixel(1 + i, 0, false);                  // D
+		recordPixel(1 + i, segHeight + 1, false);      // G
 
-		delay(animSpeed);
+		endMorphStep();
 	}
 }
 
-void Digit::Morph2() {
+void buildMorph2() {
 	for (int i = 0; i <= segWidth; i++) {
 		if (i < segWidth) {
-			drawPixel(segWidth - i, segHeight * 2 + 2, _color);
-			drawPixel(segWidth - i, segHeight + 1, _color);
-			drawPixel(segWidth - i, 0, _color);
+			recordPixel(segWidth - i, segHeight * 2 + 2, true);
+			recordPixel(segWidth - i, segHeight + 1, true);
+			recordPixel(segWidth - i, 0, true);
 		}
 
-		drawLine(segWidth + 1 - i, 1, segWidth + 1 - i, segHeight, _bg);
-		drawLine(segWidth - i, 1, segWidth - i, segHeight, _color);
-		delay(animSpeed);
+		recordLine(segWidth + 1 - i, 1, segWidth + 1 - i, segHeight, false);
+		recordLine(segWidth - i, 1, segWidth - i, segHeight, true);
+		endMorphStep();
 	}
 }
 
-void Digit::Morph3() {
+void buildMorph3() {
 	for (int i = 0; i <= segWidth; i++) {
-		drawLine(0 + i, 1, 0 + i, segHeight, _bg);
-		drawLine(1 + i, 1, 1 + i, segHeight, _color);
-		delay(animSpeed);
+		recordLine(0 + i, 1, 0 + i, segHeight, false);
+		recordLine(1 + i, 1, 1 + i, segHeight, true);
+		endMorphStep();
 	}
 }
 
-void Digit::Morph4() {
+void buildMorph4() {
 	for (int i = 0; i < segWidth; i++) {
-		drawPixel(segWidth - i, segHeight * 2 + 2, _bg);  // Erase A
-		drawPixel(0, segHeight * 2 + 1 - i, _color);      // Draw as F
-		drawPixel(1 + i, 0, _bg);                         // Erase D
-		delay(animSpeed);
+		recordPixel(segWidth - i, segHeight * 2 + 2, false);  // Erase A
+		recordPixel(0, segHeight * 2 + 1 - i, true);      // Draw as F
+		recordPixel(1 + i, 0, false);                         // Erase D
+		endMorphStep();
 	}
 }
 
-void Digit::Morph5() {
+void buildMorph5() {
 	for (int i = 0; i < segWidth; i++) {
-		drawPixel(segWidth + 1, segHeight + 2 + i, _bg);     // Erase B
-		drawPixel(segWidth - i, segHeight * 2 + 2, _color);  // Draw as A
-		drawPixel(segWidth - i, 0, _color);                  // Draw D
-		delay(animSpeed);
+		recordPixel(segWidth + 1, segHeight + 2 + i, false);     // Erase B
+		recordPixel(segWidth - i, segHeight * 2 + 2, true);  // Draw as A
+		recordPixel(segWidth - i, 0, true);                  // Draw D
+		endMorphStep();
 	}
 }
 
-void Digit::Morph6() {
+void buildMorph6() {
 	for (int i = 0; i <= segWidth; i++) {
 		// Move C right to left
-		drawLine(segWidth - i, 1, segWidth - i, segHeight, _color);
-		if (i > 0) drawLine(segWidth - i + 1, 1, segWidth - i + 1, segHeight, _bg);
-		delay(animSpeed);
+		recordLine(segWidth - i, 1, segWidth - i, segHeight, true);
+		if (i > 0) recordLine(segWidth - i + 1, 1, segWidth - i + 1, segHeight, false);
+		endMorphStep();
 	}
 }
 
-void Digit::Morph7() {
+void buildMorph7() {
 	for (int i = 0; i <= (segWidth + 1); i++) {
 		// Move E left to right
-		drawLine(0 + i - 1, 1, 0 + i - 1, segHeight, _bg);
-		drawLine(0 + i, 1, 0 + i, segHeight, _color);
+		recordLine(0 + i - 1, 1, 0 + i - 1, segHeight, false);
+		recordLine(0 + i, 1, 0 + i, segHeight, true);
 
 		// Move F left to right
-		drawLine(0 + i - 1, segHeight * 2 + 1, 0 + i - 1, segHeight + 2, _bg);
-		drawLine(0 + i, segHeight * 2 + 1, 0 + i, segHeight + 2, _color);
+		recordLine(0 + i - 1, segHeight * 2 + 1, 0 + i - 1, segHeight + 2, false);
+		recordLine(0 + i, segHeight * 2 + 1, 0 + i, segHeight + 2, true);
 
 		// Erase D and G gradually
-		drawPixel(1 + i, 0, _bg);              // D
-		drawPixel(1 + i, segHeight + 1, _bg);  // G
-		delay(animSpeed);
+		recordPixel(1 + i, 0, false);              // D
+		recordPixel(1 + i, segHeight + 1, false);  // G
+		endMorphStep();
 	}
 }
 
-void Digit::Morph8() {
+void buildMorph8() {
 	for (int i = 0; i <= segWidth; i++) {
 		// Move B right to left
-		drawLine(segWidth - i, segHeight * 2 + 1, segWidth - i, segHeight + 2, _color);
-		if (i > 0) drawLine(segWidth - i + 1, segHeight * 2 + 1, segWidth - i + 1, segHeight + 2, _bg);
+		recordLine(segWidth - i, segHeight * 2 + 1, segWidth - i, segHeight + 2, true);
+		if (i > 0) recordLine(segWidth - i + 1, segHeight * 2 + 1, segWidth - i + 1, segHeight + 2, false);
 
 		// Move C right to left
-		drawLine(segWidth - i, 1, segWidth - i, segHeight, _color);
-		if (i > 0) drawLine(segWidth - i + 1, 1, segWidth - i + 1, segHeight, _bg);
+		recordLine(segWidth - i, 1, segWidth - i, segHeight, true);
+		if (i > 0) recordLine(segWidth - i + 1, 1, segWidth - i + 1, segHeight, false);
 
 		// Gradually draw D and G
 		if (i < segWidth) {
-			drawPixel(segWidth - i, 0, _color);              // D
-			drawPixel(segWidth - i, segHeight + 1, _color);  // G
+			recordPixel(segWidth - i, 0, true);              // D
+			recordPixel(segWidth - i, segHeight + 1, true);  // G
 		}
-		delay(animSpeed);
+		endMorphStep();
 	}
 }
 
-void Digit::Morph9() {
+void buildMorph9() {
 	for (int i = 0; i <= (segWidth + 1); i++) {
 		// Move E left to right
-		drawLine(0 + i - 1, 1, 0 + i - 1, segHeight, _bg);
-		drawLine(0 + i, 1, 0 + i, segHeight, _color);
-		delay(animSpeed);
+		recordLine(0 + i - 1, 1, 0 + i - 1, segHeight, false);
+		recordLine(0 + i, 1, 0 + i, segHeight, true);
+		endMorphStep();
 	}
 }
 
-void Digit::Morph(byte newValue) {
-	switch (newValue) {
+void buildMorph(uint8_t sequence, byte from, byte to) {
+	morphFirstStep[sequence] = morphStepCount;
+
+	switch (to) {
 		case 0:
-			Morph0();
+			buildMorph0(from);
 			break;
 		case 1:
-			Morph1();
+			buildMorph1();
 			break;
 		case 2:
-			Morph2();
+			buildMorph2();
 			break;
 		case 3:
-			Morph3();
+			buildMorph3();
 			break;
 		case 4:
-			Morph4();
+			buildMorph4();
 			break;
 		case 5:
-			Morph5();
+			buildMorph5();
 			break;
 		case 6:
-			Morph6();
+			buildMorph6();
 			break;
 		case 7:
-			Morph7();
+			buildMorph7();
 			break;
 		case 8:
-			Morph8();
+			buildMorph8();
 			break;
 		case 9:
-			Morph9();
+			buildMorph9();
 			break;
 	}
 
+	morphLength[sequence] = morphStepCount - morphFirstStep[sequence];
+}
+
+void buildMorphTable() {
+	if (morphTableBuilt) {
+		return;
+	}
+
+	morphOpCount = 0;
+	morphStepCount = 0;
+	morphStepOps[0] = 0;
+
+	// Sequences 1 to 9 are the morphs to that value, and 10 onwards are the morphs to 0
+	for (byte to = 1; to <= 9; to++) {
+		buildMorph(to, to - 1, to);
+	}
+
+	for (uint8_t i = 0; i < sizeof(morphsToZero); i++) {
+		buildMorph(10 + i, morphsToZero[i], 0);
+	}
+
+	if (morphOpCount == MAX_MORPH_OPS || morphStepCount == MAX_MORPH_STEPS) {
+		Serial.println("Morph keyframe table is full; some morphs will be cut short");
+	}
+
+	morphTableBuilt = true;
+}
+
+// Which sequence morphs from one value to another, or -1 if there isn't one
+int8_t morphSequenceFor(byte from, byte to) {
+	if (to == 0) {
+		for (uint8_t i = 0; i < sizeof(morphsToZero); i++) {
+			if (morphsToZero[i] == from) {
+				return 10 + i;
+			}
+		}
+
+		return -1;
+	}
+
+	// One can be reached from zero (e.g. 10 to 11) or from two (e.g. 12 to 1 on a 12-hour clock)
+	if (to == from + 1 || (to == 1 && from == 2)) {
+		return to;
+	}
+
+	return -1;
+}
+
+void Digit::drawMorphStep(uint16_t step) {
+	for (uint16_t i = morphStepOps[step]; i < morphStepOps[step + 1]; i++) {
+		const MorphOp &op = morphOps[i];
+		uint16_t c = op.draw ? _color : _bg;
+
+		if (op.x1 == op.x2 && op.y1 == op.y2) {
+			drawPixel(op.x1, op.y1, c);
+		} else {
+			drawLine(op.x1, op.y1, op.x2, op.y2, c);
+		}
+	}
+}
+
+void Digit::finishMorph() {
+	while (StepMorph()) {
+	}
+}
+
+// Starts morphing to the new value; call StepMorph() once per frame to animate it
+void Digit::Morph(byte newValue) {
+	buildMorphTable();
+	finishMorph();
+
+	morphSequence = morphSequenceFor(_value, newValue);
+	morphStep = 0;
+
+	// There's no morph between these two values (e.g. the clock was changed), so just redraw the digit
+	if (morphSequence < 0) {
+		drawFillRect(0, segHeight * 2 + 2, segWidth + 2, segHeight * 2 + 3, _bg);
+		Draw(newValue, _color);
+	}
+
 	_value = newValue;
 }
 
-#endif
\ No newline at end of file
+// Draws the next step of the morph in progress; returns false once there's nothing left to draw
+bool Digit::StepMorph() {
+	if (morphSequence < 0) {
+		return false;
+	}
+
+	drawMorphStep(morphFirstStep[morphSequence] + morphStep);
+
+	if (++morphStep >= morphLength[morphSequence]) {
+		morphSequence = -1;
+	}
+
+	return true;
+}
+
+bool Digit::IsMorphing() {
+	return morphSequence >= 0;
+}
+
+#endif
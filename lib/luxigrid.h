@@ -164,6 +164,7 @@ void playBootAnimation();
 void playWiFiAnimation();
 void showWiFiInformation(String ssid, String ipAddressString);
 void playOTALoadingAnimation();
+void hideOTALoadingAnimation();
 void crashWithErrorCode(uint16_t errorCode);
 
 // Utility Functions
@@ -172,6 +173,11 @@ String humanReadableSize(const uint64_t bytes);
 bool stringIsNumeric(const String &str);
 String generateRandomString(int length);
 bool verifyNTPServer(const char *ntpServer);
+uint16_t measureText(const char *text, uint16_t length, uint16_t *height = NULL);
+uint16_t measureText(const String &text, uint16_t *height = NULL);
+void printText(const char *text, uint16_t length);
+void printText(const char *text);
+void printText(const String &text);
 void printCenteredText(const String &text, bool centerVertically = false);
 void printCenteredTruncatedText(String text, uint16_t margin = 4, String ellipsis = "...");
 void setTextColor(uint8_t r, uint8_t g, uint8_t b);
@@ -0,0 +1,344 @@
+/* _    _  _ _  _ _ ____ ____ _ ___
+ * |    |  |  \/  | | __ |__/ | |  \
+ * |___ |__| _/\_ | |__] |  \ | |__/
+ * =================================
+ * Luxigrid - Scrolling Marquee
+ * Copyright (c) 2024 OverScore Media - MIT License
+ * ==================================
+ *
+ * MIT LICENSE:
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef MARQUEE_GUARD
+#define MARQUEE_GUARD
+
+#include "Arduino.h"
+#include "luxigrid.h"
+
+// A marquee shows a line of text in a fixed region of the panel
+// Text that fits is drawn centred and left alone; text that doesn't scrolls round in a loop
+// The text is rendered once into a strip of 1-bit columns, so each frame is just a window copied out of the strip
+
+#define MAX_MARQUEES 4
+
+// The longest strip a marquee can hold, in columns; any text beyond this is cut off
+#define MARQUEE_MAX_COLUMNS 320
+
+// A marquee can be at most this many rows tall (one bit of a column each)
+#define MARQUEE_MAX_HEIGHT 16
+
+// The space between the end of the text and the start of it coming round again
+#define MARQUEE_GAP 16
+
+// How long new text is held still before it starts scrolling, so the start of it can be read
+#define MARQUEE_START_PAUSE 1500
+
+#define MARQUEE_DEFAULT_SPEED 16
+
+// How often delayWithMarquees() updates the marquees, in milliseconds
+#define MARQUEE_FRAME_TIME 16
+
+class Marquee;
+
+Marquee *marquees[MAX_MARQUEES];
+uint8_t marqueeCount = 0;
+
+// Blend two RGB565 colours; amount is from 0 (all background) to 256 (all foreground)
+uint16_t blendColour565(uint16_t background, uint16_t foreground, uint16_t amount) {
+	uint16_t r = (((background >> 11) & 0x1F) * (256 - amount) + ((foreground >> 11) & 0x1F) * amount) >> 8;
+	uint16_t g = (((background >> 5) & 0x3F) * (256 - amount) + ((foreground >> 5) & 0x3F) * amount) >> 8;
+	uint16_t b = ((background & 0x1F) * (256 - amount) + (foreground & 0x1F) * amount) >> 8;
+
+	return (r << 11) | (g << 5) | b;
+}
+
+class Marquee {
+	public:
+	// The region is given like text is: the left edge, the baseline, and how far the text reaches above and below it
+	Marquee(int16_t x, int16_t baseline, uint16_t width, uint8_t ascent, uint8_t descent = 0) {
+		this->x = x;
+		this->width = width;
+		this->ascent = min<uint8_t>(ascent, MARQUEE_MAX_HEIGHT);
+		height = min<uint8_t>(ascent + descent, MARQUEE_MAX_HEIGHT);
+		top = baseline - this->ascent;
+
+		// Every marquee is updated by updateMarquees(), so the app doesn't need to keep track of them
+		if (marqueeCount < MAX_MARQUEES) {
+			marquees[marqueeCount++] = this;
+		}
+	}
+
+	// Render the text into the strip and draw it; size 1 text only
+	void setText(const char *text, const GFXfont *font, uint16_t colour, uint16_t background = 0) {
+		foreground = colour;
+		this->background = background;
+
+		renderStrip(text, font);
+
+		position = 0;
+		scrollStart = millis() + MARQUEE_START_PAUSE;
+		active = true;
+		needsRedraw = true;
+
+		update(millis());
+	}
+
+	void setText(const String &text, const GFXfont *font, uint16_t colour, uint16_t background = 0) {
+		setText(text.c_str(), font, colour, background);
+	}
+
+	// Scrolling speed, in pixels per second
+	void setSpeed(uint8_t pixelsPerSecond) {
+		speed = pixelsPerSecond;
+	}
+
+	// With smoothing on, the text moves in sixteenths of a pixel, with each pixel lit in proportion to how much of the text covers it
+	// With it off, the text jumps a whole pixel at a time
+	void setSmoothing(bool smooth) {
+		this->smooth = smooth;
+		needsRedraw = true;
+	}
+
+	// Text that fits is centred in the region by default, or can be lined up with its left edge like printText() would
+	void setCentred(bool centred) {
+		this->centred = centred;
+	}
+
+	// Stop updating the region (e.g. when something else is about to be drawn there)
+	void stop() {
+		active = false;
+	}
+
+	bool isScrolling() {
+		return active && scrolls;
+	}
+
+	// Draw the marquee again on the next update, e.g. after the screen has been cleared
+	void invalidate() {
+		needsRedraw = true;
+	}
+
+	void update(unsigned long now) {
+		if (!active) {
+			return;
+		}
+
+		// Leave the screen alone while the OTA update screen is showing, and draw everything again once it's gone
+		if (otaUpdateInProgress) {
+			needsRedraw = true;
+			return;
+		}
+
+		if (scrolls && (long)(now - scrollStart) > 0) {
+			// Worked out from the time since scrolling started, so the speed stays steady however unevenly this is called
+			position = ((uint64_t)(now - scrollStart) * speed * 256 / 1000) % ((uint32_t)stripLength << 8);
+		}
+
+		// Only draw when the text has moved far enough to make a difference
+		uint32_t step = smooth ? position >> 4 : position >> 8;
+
+		if (step == drawnStep && !needsRedraw) {
+			return;
+		}
+
+		draw();
+
+		drawnStep = step;
+		needsRedraw = false;
+	}
+
+	private:
+	// Fill the strip with the text, one bit per pixel, starting from the top row
+	void renderStrip(const char *text, const GFXfont *font) {
+		memset(columns, 0, sizeof(columns));
+
+		uint8_t first = pgm_read_byte(&font->first);
+		uint8_t last = pgm_read_byte(&font->last);
+		const uint8_t *bitmap = (const uint8_t *)pgm_read_ptr(&font->bitmap);
+		GFXglyph *glyphs = (GFXglyph *)pgm_read_ptr(&font->glyph);
+
+		// Find how far the text reaches to the left and right, so it can be placed in the strip
+		int16_t cursor = 0, minX = INT16_MAX, maxX = INT16_MIN;
+
+		for (const char *c = text; *c; c++) {
+			if ((uint8_t)*c < first || (uint8_t)*c > last) {
+				continue;
+			}
+
+			const GFXglyph *glyph = &glyphs[(uint8_t)*c - first];
+			uint8_t glyphWidth = pgm_read_byte(&glyph->width);
+			int8_t xOffset = pgm_read_byte(&glyph->xOffset);
+
+			if (glyphWidth > 0) {
+				minX = min<int16_t>(minX, cursor + xOffset);
+				maxX = max<int16_t>(maxX, cursor + xOffset + glyphWidth - 1);
+			}
+
+			cursor += pgm_read_byte(&glyph->xAdvance);
+		}
+
+		uint16_t textWidth = maxX >= minX ? maxX - minX + 1 : 0;
+
+		// Text that fits goes in a strip the width of the region, which never moves
+		// Otherwise, the strip is the text followed by a gap, and wraps around as it scrolls
+		int16_t origin;
+
+		if (textWidth <= width) {
+			scrolls = false;
+			stripLength = max<uint16_t>(width, 1);
+			origin = centred && textWidth > 0 ? (width - textWidth) / 2 - minX : 0;
+		} else {
+			scrolls = true;
+			stripLength = min<uint16_t>(textWidth, MARQUEE_MAX_COLUMNS - MARQUEE_GAP) + MARQUEE_GAP;
+			origin = -minX;
+		}
+
+		// Text cut off at the end of the strip still leaves the gap clear
+		uint16_t textColumns = scrolls ? stripLength - MARQUEE_GAP : stripLength;
+		cursor = origin;
+
+		for (const char *c = text; *c; c++) {
+			if ((uint8_t)*c < first || (uint8_t)*c > last) {
+				continue;
+			}
+
+			const GFXglyph *glyph = &glyphs[(uint8_t)*c - first];
+			uint8_t glyphWidth = pgm_read_byte(&glyph->width);
+			uint8_t glyphHeight = pgm_read_byte(&glyph->height);
+			int8_t xOffset = pgm_read_byte(&glyph->xOffset);
+			int8_t yOffset = pgm_read_byte(&glyph->yOffset);
+
+			// The bitmap is packed one bit per pixel, row after row, without padding between rows
+			uint16_t offset = pgm_read_word(&glyph->bitmapOffset);
+			uint8_t bits = 0, bit = 0;
+
+			for (uint8_t gy = 0; gy < glyphHeight; gy++) {
+				int16_t row = ascent + yOffset + gy;
+
+				for (uint8_t gx = 0; gx < glyphWidth; gx++) {
+					if (!(bit++ & 7)) {
+						bits = pgm_read_byte(&bitmap[offset++]);
+					}
+
+					bool lit = bits & 0x80;
+					bits <<= 1;
+
+					int16_t column = cursor + xOffset + gx;
+
+					if (lit && row >= 0 && row < height && column >= 0 && column < textColumns) {
+						columns[column] |= 1 << row;
+					}
+				}
+			}
+
+			cursor += pgm_read_byte(&glyph->xAdvance);
+		}
+	}
+
+	// Copy the window at the current position out of the strip, one run of same-coloured pixels at a time
+	void draw() {
+		uint16_t whole = position >> 8;
+		uint16_t fraction = smooth ? position & 0xF0 : 0;
+
+		// Each panel pixel is covered by two strip columns: the one it's mostly over (bit 0) and the next one along (bit 1)
+		uint16_t colours[4] = {
+		    background,
+		    blendColour565(background, foreground, 256 - fraction),
+		    blendColour565(background, foreground, fraction),
+		    foreground,
+		};
+
+		for (uint8_t row = 0; row < height; row++) {
+			uint16_t mask = 1 << row;
+			uint16_t column = whole % stripLength;
+			int16_t runStart = 0;
+			uint8_t runColour = 0;
+
+			for (uint16_t i = 0; i <= width; i++) {
+				uint8_t colour = 0;
+
+				if (i < width) {
+					uint16_t next = column + 1 == stripLength ? 0 : column + 1;
+
+					colour = ((columns[column] & mask) ? 1 : 0) | ((columns[next] & mask) ? 2 : 0);
+					column = next;
+				}
+
+				if (i == width || (i > 0 && colour != runColour)) {
+					dma_display->drawFastHLine(x + runStart, top + row, i - runStart, colours[runColour]);
+					runStart = i;
+				}
+
+				runColour = colour;
+			}
+		}
+	}
+
+	int16_t x;
+	int16_t top;
+	uint16_t width;
+	uint8_t ascent;
+	uint8_t height;
+
+	uint16_t columns[MARQUEE_MAX_COLUMNS];
+	uint16_t stripLength = 1;
+
+	uint16_t foreground = 0;
+	uint16_t background = 0;
+	uint8_t speed = MARQUEE_DEFAULT_SPEED;
+	bool smooth = true;
+	bool centred = true;
+
+	bool active = false;
+	bool scrolls = false;
+	bool needsRedraw = false;
+
+	// Position along the strip in 1/256ths of a pixel
+	uint32_t position = 0;
+	uint32_t drawnStep = 0;
+	unsigned long scrollStart = 0;
+};
+
+// Update every marquee that's showing; apps with a frame loop call this once per frame
+void updateMarquees() {
+	unsigned long now = millis();
+
+	for (uint8_t i = 0; i < marqueeCount; i++) {
+		marquees[i]->update(now);
+	}
+}
+
+// A drop-in replacement for delay() that keeps the marquees moving while it waits
+void delayWithMarquees(unsigned long duration) {
+	unsigned long start = millis();
+
+	for (;;) {
+		updateMarquees();
+
+		unsigned long elapsed = millis() - start;
+
+		if (elapsed >= duration) {
+			return;
+		}
+
+		delay(min<unsigned long>(duration - elapsed, MARQUEE_FRAME_TIME));
+	}
+}
+
+#endif
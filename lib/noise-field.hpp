@@ -0,0 +1,165 @@
+/* _    _  _ _  _ _ ____ ____ _ ___
+ * |    |  |  \/  | | __ |__/ | |  \
+ * |___ |__| _/\_ | |__] |  \ | |__/
+ * =================================
+ * Luxigrid - Noise Field Helper Functions
+ * Copyright (c) 2024 OverScore Media - MIT License
+ *
+ * Adapted from Aurora: https://github.com/pixelmatix/aurora
+ *
+ * Original Copyright Notice:
+ * ==================================================
+ * Copyright (c) 2014 Jason Coon - MIT License
+ *
+ * Portions of this code are adapted from FastLED Fire2012 example by Mark Kriegsman:
+ * https://github.com/FastLED/FastLED/blob/master/examples/Noise/Noise.ino
+ * Copyright (c) 2013 FastLED
+ * ==================================
+ *
+ * MIT LICENSE:
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef NOISE_FIELD_GUARD
+#define NOISE_FIELD_GUARD
+
+#include "Arduino.h"
+#include "luxigrid.h"
+
+#include "animation-helpers.hpp"
+
+// When the noise changes slowly across the panel (i.e. the scale is small), it's only sampled every NOISE_LATTICE_STEP pixels,
+// and the pixels in between are bilinearly interpolated
+// At scales up to NOISE_COARSE_MAX_SCALE, a lattice cell spans at most a quarter of a noise cell, so the difference can't be seen
+#define NOISE_LATTICE_STEP 2
+#define NOISE_COARSE_MAX_SCALE 8192
+
+#define NOISE_LATTICE_WIDTH (MATRIX_WIDTH / NOISE_LATTICE_STEP + 1)
+#define NOISE_LATTICE_HEIGHT (MATRIX_HEIGHT / NOISE_LATTICE_STEP + 1)
+
+// If the field has moved less than this (in noise space) since it was last sampled, the last samples are reused
+// The smoothing hides the difference, since each frame only moves the field a small part of the way towards the samples anyway
+#define NOISE_REUSE_DISTANCE 256
+
+// A smoothed 3D noise field covering the panel, stored row-major in one buffer
+class NoiseField {
+	public:
+	// Position and scale in noise space
+	uint32_t x = 0, y = 0, z = 0;
+	uint32_t scaleX = 6000, scaleY = 6000;
+
+	// How much of the previous frame to keep each frame (out of 256)
+	uint8_t smoothing = 200;
+
+	uint8_t at(uint16_t px, uint16_t py) const {
+		return field[py * MATRIX_WIDTH + px];
+	}
+
+	// Sample the noise at the current position, and move the field towards it
+	void fill() {
+		if (!hasSamples || moved(sampledX, x) || moved(sampledY, y) || moved(sampledZ, z) || scaleX != sampledScaleX || scaleY != sampledScaleY) {
+			sample();
+		}
+
+		parallelFor(MATRIX_HEIGHT, [this](uint16_t py) {
+			uint8_t *row = &field[py * MATRIX_WIDTH];
+			const uint8_t *sampleRow = &samples[py * MATRIX_WIDTH];
+
+			for (uint16_t px = 0; px < MATRIX_WIDTH; px++) {
+				row[px] = scale8(row[px], smoothing) + scale8(sampleRow[px], 256 - smoothing);
+			}
+		});
+	}
+
+	// Draw the field into leds, with each value picking both the colour and the brightness
+	void show(uint8_t colorrepeat, uint8_t colorshift) {
+		parallelFor(MATRIX_HEIGHT, [this, colorrepeat, colorshift](uint16_t py) {
+			const uint8_t *row = &field[py * MATRIX_WIDTH];
+
+			for (uint16_t px = 0; px < MATRIX_WIDTH; px++) {
+				uint8_t pixel = row[px];
+				leds[XY16(px, py)] = paletteLookup(colorrepeat * (pixel + colorshift), pixel);
+			}
+		});
+	}
+
+	private:
+	static bool moved(uint32_t from, uint32_t to) {
+		return abs((int32_t)(to - from)) >= NOISE_REUSE_DISTANCE;
+	}
+
+	// Noise at a pixel; the offsets are measured from the centre of the panel (along y for both axes, as in the original)
+	uint16_t noiseAt(int16_t px, int16_t py) const {
+		uint32_t xoffset = scaleX * (px - MATRIX_CENTER_Y);
+		uint32_t yoffset = scaleY * (py - MATRIX_CENTER_Y);
+
+		return inoise16(x + xoffset, y + yoffset, z);
+	}
+
+	void sample() {
+		sampledX = x;
+		sampledY = y;
+		sampledZ = z;
+		sampledScaleX = scaleX;
+		sampledScaleY = scaleY;
+		hasSamples = true;
+
+		if (scaleX > NOISE_COARSE_MAX_SCALE || scaleY > NOISE_COARSE_MAX_SCALE) {
+			parallelFor(MATRIX_HEIGHT, [this](uint16_t py) {
+				for (uint16_t px = 0; px < MATRIX_WIDTH; px++) {
+					samples[py * MATRIX_WIDTH + px] = noiseAt(px, py) >> 8;
+				}
+			});
+
+			return;
+		}
+
+		parallelFor(NOISE_LATTICE_HEIGHT, [this](uint16_t ly) {
+			for (uint16_t lx = 0; lx < NOISE_LATTICE_WIDTH; lx++) {
+				lattice[ly * NOISE_LATTICE_WIDTH + lx] = noiseAt(lx * NOISE_LATTICE_STEP, ly * NOISE_LATTICE_STEP);
+			}
+		});
+
+		parallelFor(MATRIX_HEIGHT, [this](uint16_t py) {
+			uint16_t ly = py / NOISE_LATTICE_STEP;
+			uint32_t fy = py % NOISE_LATTICE_STEP;
+			const uint16_t *top = &lattice[ly * NOISE_LATTICE_WIDTH];
+			const uint16_t *bottom = top + NOISE_LATTICE_WIDTH;
+
+			for (uint16_t px = 0; px < MATRIX_WIDTH; px++) {
+				uint16_t lx = px / NOISE_LATTICE_STEP;
+				uint32_t fx = px % NOISE_LATTICE_STEP;
+
+				uint32_t upper = top[lx] * (NOISE_LATTICE_STEP - fx) + top[lx + 1] * fx;
+				uint32_t lower = bottom[lx] * (NOISE_LATTICE_STEP - fx) + bottom[lx + 1] * fx;
+				uint32_t value = (upper * (NOISE_LATTICE_STEP - fy) + lower * fy) / (NOISE_LATTICE_STEP * NOISE_LATTICE_STEP);
+
+				samples[py * MATRIX_WIDTH + px] = value >> 8;
+			}
+		});
+	}
+
+	alignas(4) uint8_t field[MATRIX_WIDTH * MATRIX_HEIGHT] = {};
+	alignas(4) uint8_t samples[MATRIX_WIDTH * MATRIX_HEIGHT];
+	uint16_t lattice[NOISE_LATTICE_WIDTH * NOISE_LATTICE_HEIGHT];
+
+	uint32_t sampledX, sampledY, sampledZ, sampledScaleX, sampledScaleY;
+	bool hasSamples = false;
+};
+
+#endif
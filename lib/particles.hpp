@@ -0,0 +1,369 @@
+/* _    _  _ _  _ _ ____ ____ _ ___
+ * |    |  |  \/  | | __ |__/ | |  \
+ * |___ |__| _/\_ | |__] |  \ | |__/
+ * =================================
+ * Luxigrid - Particle System
+ * Copyright (c) 2024 OverScore Media - MIT License
+ *
+ * Adapted from Aurora: https://github.com/pixelmatix/aurora
+ *
+ * Original Copyright Notice:
+ * ==================================================
+ * Copyright (c) 2014 Jason Coon - MIT License
+ *
+ * Portions of this code are adapted from "Flocking" in "The Nature of Code" by Daniel Shiffman: http://natureofcode.com/
+ * Copyright (c) 2014 Daniel Shiffman
+ * http://www.shiffman.net
+ *
+ * Demonstration of Craig Reynolds' "Flocking" behavior: http://www.red3d.com/cwr/
+ * ==================================
+ *
+ * MIT LICENSE:
+ * Permission is hereby granted, free of charge, to any person obtaining a copy of
+ * this software and associated documentation files (the "Software"), to deal in
+ * the Software without restriction, including without limitation the rights to
+ * use, copy, modify, merge, publish, distribute, sublicense, and/or sell copies of
+ * the Software, and to permit persons to whom the Software is furnished to do so,
+ * subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS
+ * FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR
+ * COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER LIABILITY, WHETHER
+ * IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, OUT OF OR IN
+ * CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#ifndef PARTICLES_GUARD
+#define PARTICLES_GUARD
+
+#include "Arduino.h"
+#include <FastLED.h>
+
+#include "luxigrid.h"
+#include "Vector.h"
+
+// A particle system for the boid-style animations (flock, flow field, attract)
+// Particle state is kept in separate arrays (x, y, vx, ...) rather than an array of objects, so each pass only touches the data it
+// needs and its loop is simple enough for the compiler to unroll
+// Each frame, forces are added to the accumulators (ax, ay) by the apply*() functions below, then integrate() moves everything along
+
+// Shared by the steering maths: scale (x, y) to length 1, or down to length max if it's longer than that
+inline void normalizeVector(float &x, float &y) {
+	float lengthSq = x * x + y * y;
+
+	if (lengthSq > 0) {
+		float scale = fastInverseSqrt(lengthSq);
+		x *= scale;
+		y *= scale;
+	}
+}
+
+inline void limitVector(float &x, float &y, float max) {
+	float lengthSq = x * x + y * y;
+
+	if (lengthSq > max * max) {
+		float scale = max * fastInverseSqrt(lengthSq);
+		x *= scale;
+		y *= scale;
+	}
+}
+
+template <uint16_t CAPACITY>
+class ParticleSystem {
+	public:
+	uint16_t count = 0;
+
+	float x[CAPACITY], y[CAPACITY];
+	float vx[CAPACITY], vy[CAPACITY];
+	float ax[CAPACITY], ay[CAPACITY];
+	float mass[CAPACITY];
+	uint8_t colour[CAPACITY];
+
+	// These are shared by every particle in the system
+	float maxSpeed = 1.5;
+	float maxForce = 0.05;
+	float desiredSeparation = 4;
+	float neighbourDistance = 8;
+
+	// Returns the new particle's index, or CAPACITY if the system is full
+	uint16_t add(float px, float py) {
+		if (count >= CAPACITY) {
+			return CAPACITY;
+		}
+
+		uint16_t i = count++;
+		x[i] = px;
+		y[i] = py;
+		vx[i] = randomVelocity();
+		vy[i] = randomVelocity();
+		ax[i] = 0;
+		ay[i] = 0;
+		mass[i] = 1;
+		colour[i] = 0;
+
+		return i;
+	}
+
+	static float randomVelocity() {
+		return random(0, 255) / 255.0 - 0.5;
+	}
+
+	// Apply the accumulated forces, limit the speed, move, and clear the accumulators for the next frame
+	void integrate() {
+		for (uint16_t i = 0; i < count; i++) {
+			vx[i] += ax[i];
+			vy[i] += ay[i];
+		}
+
+		for (uint16_t i = 0; i < count; i++) {
+			limitVector(vx[i], vy[i], maxSpeed);
+		}
+
+		for (uint16_t i = 0; i < count; i++) {
+			x[i] += vx[i];
+			y[i] += vy[i];
+		}
+
+		memset(ax, 0, count * sizeof(float));
+		memset(ay, 0, count * sizeof(float));
+	}
+
+	void wrapAroundBorders() {
+		for (uint16_t i = 0; i < count; i++) {
+			if (x[i] < 0) {
+				x[i] = MATRIX_WIDTH - 1;
+			} else if (x[i] >= MATRIX_WIDTH) {
+				x[i] = 0;
+			}
+
+			if (y[i] < 0) {
+				y[i] = MATRIX_HEIGHT - 1;
+			} else if (y[i] >= MATRIX_HEIGHT) {
+				y[i] = 0;
+			}
+		}
+	}
+
+	bool isOffScreen(uint16_t i) const {
+		return x[i] < 0 || x[i] >= MATRIX_WIDTH || y[i] < 0 || y[i] >= MATRIX_HEIGHT;
+	}
+
+	// Steering = Desired - Velocity, limited to the maximum force
+	void steer(uint16_t i, float desiredX, float desiredY) {
+		float steerX = desiredX - vx[i];
+		float steerY = desiredY - vy[i];
+		limitVector(steerX, steerY, maxForce);
+
+		ax[i] += steerX;
+		ay[i] += steerY;
+	}
+};
+
+// A uniform grid over the panel, so that flocking particles only look at the particles in nearby cells, rather than every other particle
+// Rebuild it with build() once a frame, before applying any forces that use it
+#define PARTICLE_GRID_CELL_SIZE 8
+#define PARTICLE_GRID_COLUMNS ((MATRIX_WIDTH + PARTICLE_GRID_CELL_SIZE - 1) / PARTICLE_GRID_CELL_SIZE)
+#define PARTICLE_GRID_ROWS ((MATRIX_HEIGHT + PARTICLE_GRID_CELL_SIZE - 1) / PARTICLE_GRID_CELL_SIZE)
+#define PARTICLE_GRID_CELLS (PARTICLE_GRID_COLUMNS * PARTICLE_GRID_ROWS)
+#define PARTICLE_GRID_MAX_PARTICLES 512
+
+class ParticleGrid {
+	public:
+	// The particles in cell c are members[cellStart[c]] up to (but not including) members[cellStart[c + 1]]
+	uint16_t cellStart[PARTICLE_GRID_CELLS + 1];
+	uint16_t members[PARTICLE_GRID_MAX_PARTICLES];
+
+	// A counting sort of the particles by cell
+	template <uint16_t CAPACITY>
+	void build(const ParticleSystem<CAPACITY> &particles) {
+		uint16_t count = min(particles.count, (uint16_t)PARTICLE_GRID_MAX_PARTICLES);
+		memset(cellStart, 0, sizeof(cellStart));
+
+		for (uint16_t i = 0; i < count; i++) {
+			cellOf[i] = row(particles.y[i]) * PARTICLE_GRID_COLUMNS + column(particles.x[i]);
+			cellStart[cellOf[i] + 1]++;
+		}
+
+		for (uint16_t cell = 0; cell < PARTICLE_GRID_CELLS; cell++) {
+			cellStart[cell + 1] += cellStart[cell];
+		}
+
+		uint16_t next[PARTICLE_GRID_CELLS];
+		memcpy(next, cellStart, sizeof(next));
+
+		for (uint16_t i = 0; i < count; i++) {
+			members[next[cellOf[i]]++] = i;
+		}
+	}
+
+	// Particles can stray a little outside the panel, so these clamp to the edge cells
+	static uint8_t column(float x) {
+		return constrain((int)floorf(x / PARTICLE_GRID_CELL_SIZE), 0, PARTICLE_GRID_COLUMNS - 1);
+	}
+
+	static uint8_t row(float y) {
+		return constrain((int)floorf(y / PARTICLE_GRID_CELL_SIZE), 0, PARTICLE_GRID_ROWS - 1);
+	}
+
+	private:
+	uint8_t cellOf[PARTICLE_GRID_MAX_PARTICLES];
+};
+
+// Separation, Alignment, and Cohesion, against the particles in neighbours (which can be the same system)
+// All three only care about nearby particles, so they're worked out together, in one pass over the surrounding grid cells
+template <uint16_t CAPACITY, uint16_t NEIGHBOUR_CAPACITY>
+void applyFlocking(ParticleSystem<CAPACITY> &particles, const ParticleSystem<NEIGHBOUR_CAPACITY> &neighbours, const ParticleGrid &grid) {
+	float radius = max(particles.neighbourDistance, particles.desiredSeparation);
+	float neighbourDistanceSq = particles.neighbourDistance * particles.neighbourDistance;
+	float desiredSeparationSq = particles.desiredSeparation * particles.desiredSeparation;
+
+	for (uint16_t i = 0; i < particles.count; i++) {
+		float px = particles.x[i], py = particles.y[i];
+
+		float sepX = 0, sepY = 0;
+		float velocitySumX = 0, velocitySumY = 0;
+		float locationSumX = 0, locationSumY = 0;
+		int sepCount = 0;
+		int count = 0;
+
+		uint8_t firstColumn = ParticleGrid::column(px - radius), lastColumn = ParticleGrid::column(px + radius);
+		uint8_t firstRow = ParticleGrid::row(py - radius), lastRow = ParticleGrid::row(py + radius);
+
+		for (uint8_t row = firstRow; row <= lastRow; row++) {
+			for (uint8_t column = firstColumn; column <= lastColumn; column++) {
+				uint16_t cell = row * PARTICLE_GRID_COLUMNS + column;
+
+				for (uint16_t k = grid.cellStart[cell]; k < grid.cellStart[cell + 1]; k++) {
+					uint16_t j = grid.members[k];
+
+					float dx = px - neighbours.x[j];
+					float dy = py - neighbours.y[j];
+					float dSq = dx * dx + dy * dy;
+
+					// 0 when you are yourself
+					if (dSq == 0) {
+						continue;
+					}
+
+					// Vector pointing away from the neighbour, normalized and weighted by distance (i.e. divided by the distance twice)
+					if (dSq < desiredSeparationSq) {
+						sepX += dx / dSq;
+						sepY += dy / dSq;
+						sepCount++;
+					}
+
+					if (dSq < neighbourDistanceSq) {
+						velocitySumX += neighbours.vx[j];
+						velocitySumY += neighbours.vy[j];
+						locationSumX += neighbours.x[j];
+						locationSumY += neighbours.y[j];
+						count++;
+					}
+				}
+			}
+		}
+
+		// Separation: steer away from particles that are too close (weighted 1.5 against the other two)
+		if (sepCount > 0 && (sepX != 0 || sepY != 0)) {
+			normalizeVector(sepX, sepY);
+			float desiredX = sepX * particles.maxSpeed, desiredY = sepY * particles.maxSpeed;
+
+			float steerX = desiredX - particles.vx[i], steerY = desiredY - particles.vy[i];
+			limitVector(steerX, steerY, particles.maxForce);
+
+			particles.ax[i] += steerX * 1.5;
+			particles.ay[i] += steerY * 1.5;
+		}
+
+		if (count > 0) {
+			// Alignment: steer towards the average velocity of nearby particles
+			normalizeVector(velocitySumX, velocitySumY);
+			particles.steer(i, velocitySumX * particles.maxSpeed, velocitySumY * particles.maxSpeed);
+
+			// Cohesion: steer towards the average location (i.e. center) of nearby particles
+			float desiredX = locationSumX / count - px, desiredY = locationSumY / count - py;
+			normalizeVector(desiredX, desiredY);
+			particles.steer(i, desiredX * particles.maxSpeed, desiredY * particles.maxSpeed);
+		}
+	}
+}
+
+// Push particles away from an obstacle once it's within radius of where they're heading
+template <uint16_t CAPACITY>
+void applyRepulsion(ParticleSystem<CAPACITY> &particles, float obstacleX, float obstacleY, float radius) {
+	for (uint16_t i = 0; i < particles.count; i++) {
+		// Calculate future position for more effective behaviour
+		float dx = obstacleX - (particles.x[i] + particles.vx[i]);
+		float dy = obstacleY - (particles.y[i] + particles.vy[i]);
+		float dSq = dx * dx + dy * dy;
+
+		if (dSq <= radius * radius) {
+			float repelX = particles.x[i] - obstacleX;
+			float repelY = particles.y[i] - obstacleY;
+			normalizeVector(repelX, repelY);
+
+			// Don't divide by zero
+			if (dSq != 0) {
+				repelX *= particles.maxForce * 7;
+				repelY *= particles.maxForce * 7;
+			}
+
+			particles.ax[i] += repelX;
+			particles.ay[i] += repelY;
+		}
+	}
+}
+
+// Gravity towards a point, limiting the distance to eliminate "extreme" results for very close or very far particles
+template <uint16_t CAPACITY>
+void applyAttractor(ParticleSystem<CAPACITY> &particles, float attractorX, float attractorY, float attractorMass, float G) {
+	for (uint16_t i = 0; i < particles.count; i++) {
+		float forceX = attractorX - particles.x[i];
+		float forceY = attractorY - particles.y[i];
+		float dSq = forceX * forceX + forceY * forceY;
+
+		if (dSq == 0) {
+			continue;
+		}
+
+		// Normalize, and work out the (limited) distance, from the one inverse square root
+		float inverseD = fastInverseSqrt(dSq);
+		float d = constrain(dSq * inverseD, 5.0f, 32.0f);
+
+		forceX *= inverseD;
+		forceY *= inverseD;
+		float strength = (G * attractorMass * particles.mass[i]) / (d * d);
+
+		particles.ax[i] += forceX * strength;
+		particles.ay[i] += forceY * strength;
+	}
+}
+
+template <uint16_t CAPACITY>
+void applyWind(ParticleSystem<CAPACITY> &particles, float windX, float windY) {
+	for (uint16_t i = 0; i < particles.count; i++) {
+		particles.ax[i] += windX;
+		particles.ay[i] += windY;
+	}
+}
+
+// Point every particle along a 3D noise field (rather than pushing it); each particle's colour is set to hue plus its heading
+template <uint16_t CAPACITY>
+void steerByNoise(ParticleSystem<CAPACITY> &particles, uint16_t noiseX, uint16_t noiseY, uint16_t noiseZ, uint16_t scale, uint8_t hue) {
+	for (uint16_t i = 0; i < particles.count; i++) {
+		int ioffset = scale * particles.x[i];
+		int joffset = scale * particles.y[i];
+
+		uint8_t angle = inoise8(noiseX + ioffset, noiseY + joffset, noiseZ);
+
+		particles.vx[i] = (float)sin8(angle) * 0.0078125 - 1.0;
+		particles.vy[i] = -((float)cos8(angle) * 0.0078125 - 1.0);
+		particles.colour[i] = angle + hue;
+	}
+}
+
+#endif
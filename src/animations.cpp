@@ -1,5 +1,6 @@
 #include "Arduino.h"
 #include "../lib/luxigrid.h"
+#include "../lib/compositor.h"
 
 void drawLuxigridLogo(uint16_t color) {
 	// L
@@ -271,22 +272,70 @@ uint16_t getOTALoadingAnimationProgressColour() {
 	return dma_display->color565(r, g, b);
 }
 
+// The OTA update progress is shown in a box over whatever the app was showing, rather than clearing the screen for it
+#define OTA_OVERLAY_Y 4
+#define OTA_OVERLAY_HEIGHT 25
+#define OTA_OVERLAY_ALPHA 216
+
+AlphaCanvas otaOverlay(PANEL_RES_X, OTA_OVERLAY_HEIGHT);
+bool otaOverlayShown = false;
+
+// Print text centred across the overlay, with its baseline at y
+void printOTAOverlayText(const String &text, int16_t y) {
+	int16_t x1, y1;
+	uint16_t w, h;
+
+	otaOverlay.getTextBounds(text, 0, y, &x1, &y1, &w, &h);
+	otaOverlay.setCursor((PANEL_RES_X - w) / 2, y);
+	otaOverlay.print(text);
+}
+
 // Play the animation shown while an OTA update is in progress
 void playOTALoadingAnimation() {
-	dma_display->setTextColor(dma_display->color565(255, 255, 255));
-	dma_display->setFont(&Org_01);
-	printCenteredText("UPDATING...", true);
+	if (!otaOverlayShown) {
+		compositor.addLayer(&otaOverlay, 0, OTA_OVERLAY_Y);
+		otaOverlayShown = true;
+	}
+
+	uint16_t progressColour = getOTALoadingAnimationProgressColour();
+	uint8_t percentComplete = (otaUpdatePercentComplete > 100) ? 100 : otaUpdatePercentComplete;
+
+	// The whole box is drawn every time, in case the app was halfway through a frame when the update started
+	// Over the animations (which go through the compositor), only the pixels that come out different are actually sent to the panel
+	otaOverlay.setDrawAlpha(OTA_OVERLAY_ALPHA);
+	otaOverlay.fillScreen(0);
+	otaOverlay.setDrawAlpha(255);
+
+	otaOverlay.setFont(&Org_01);
+	otaOverlay.setTextSize(1);
+	otaOverlay.setTextWrap(false);
+	otaOverlay.setTextColor(dma_display->color565(255, 255, 255));
+	printOTAOverlayText("UPDATING...", 9);
 
-	// Black rectangle behind the text (alternative to clearing the whole screen)
-	dma_display->fillRect(23, 22, 17, 5, dma_display->color565(0, 0, 0));
 	// Display the upload progress
-	dma_display->setCursor(dma_display->getCursorX(), 26);
-	dma_display->setTextColor(getOTALoadingAnimationProgressColour());
-	printCenteredText(String(otaUpdatePercentComplete) + "%");
+	otaOverlay.setTextColor(progressColour);
+	printOTAOverlayText(String(otaUpdatePercentComplete) + "%", 17);
+
+	// Progress bar
+	otaOverlay.fillRect(8, 20, PANEL_RES_X - 16, 2, dma_display->color565(40, 40, 40));
+	otaOverlay.fillRect(8, 20, (PANEL_RES_X - 16) * percentComplete / 100, 2, progressColour);
+
+	compositor.present();
 
 	vTaskDelay(250 / portTICK_PERIOD_MS);
 }
 
+// Take the OTA update box away again (if an update has been cancelled), showing whatever's underneath it
+void hideOTALoadingAnimation() {
+	if (!otaOverlayShown) {
+		return;
+	}
+
+	compositor.removeLayer(&otaOverlay);
+	compositor.present();
+	otaOverlayShown = false;
+}
+
 void crashWithErrorCode(uint16_t errorCode) {
 	dma_display->clearScreen();
 	dma_display->setFont(&Org_01);
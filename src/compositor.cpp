@@ -0,0 +1,323 @@
+#include "Arduino.h"
+#include "../lib/luxigrid.h"
+#include "../lib/compositor.h"
+
+Compositor compositor;
+
+///////////////////
+// ALPHA CANVAS
+///////////////////
+// Canvases are often globals, constructed before the panel is set up, so (like GFXcanvas16) one that couldn't be allocated just does nothing
+AlphaCanvas::AlphaCanvas(uint16_t width, uint16_t height) : Adafruit_GFX(width, height) {
+	colours = (uint16_t *)calloc(width * height, sizeof(uint16_t));
+	alphas = (uint8_t *)calloc(width * height, 1);
+
+	if (colours == NULL || alphas == NULL) {
+		free(colours);
+		free(alphas);
+		colours = NULL;
+		alphas = NULL;
+	}
+}
+
+AlphaCanvas::~AlphaCanvas() {
+	free(colours);
+	free(alphas);
+}
+
+void AlphaCanvas::fillClipped(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t colour, uint8_t alpha) {
+	if (x < 0) {
+		w += x;
+		x = 0;
+	}
+
+	if (y < 0) {
+		h += y;
+		y = 0;
+	}
+
+	w = min<int16_t>(w, WIDTH - x);
+	h = min<int16_t>(h, HEIGHT - y);
+
+	if (w <= 0 || h <= 0 || colours == NULL) {
+		return;
+	}
+
+	for (int16_t row = y; row < y + h; row++) {
+		uint16_t *colour565 = &colours[row * WIDTH + x];
+
+		for (int16_t i = 0; i < w; i++) {
+			colour565[i] = colour;
+		}
+
+		memset(&alphas[row * WIDTH + x], alpha, w);
+	}
+
+	dirty.add(x, y, w, h);
+}
+
+void AlphaCanvas::drawPixel(int16_t x, int16_t y, uint16_t colour) {
+	if (x < 0 || y < 0 || x >= WIDTH || y >= HEIGHT || colours == NULL) {
+		return;
+	}
+
+	colours[y * WIDTH + x] = colour;
+	alphas[y * WIDTH + x] = drawAlpha;
+	dirty.add(x, y, 1, 1);
+}
+
+void AlphaCanvas::drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t colour) {
+	fillClipped(x, y, w, 1, colour, drawAlpha);
+}
+
+void AlphaCanvas::drawFastVLine(int16_t x, int16_t y, int16_t h, uint16_t colour) {
+	fillClipped(x, y, 1, h, colour, drawAlpha);
+}
+
+void AlphaCanvas::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t colour) {
+	fillClipped(x, y, w, h, colour, drawAlpha);
+}
+
+void AlphaCanvas::fillScreen(uint16_t colour) {
+	fillClipped(0, 0, WIDTH, HEIGHT, colour, drawAlpha);
+}
+
+void AlphaCanvas::clear() {
+	fillClipped(0, 0, WIDTH, HEIGHT, 0, 0);
+}
+
+void AlphaCanvas::clearRect(int16_t x, int16_t y, int16_t w, int16_t h) {
+	fillClipped(x, y, w, h, 0, 0);
+}
+
+uint16_t AlphaCanvas::getPixel(int16_t x, int16_t y) const {
+	if (x < 0 || y < 0 || x >= WIDTH || y >= HEIGHT || colours == NULL) {
+		return 0;
+	}
+
+	return colours[y * WIDTH + x];
+}
+
+uint8_t AlphaCanvas::getAlpha(int16_t x, int16_t y) const {
+	if (x < 0 || y < 0 || x >= WIDTH || y >= HEIGHT || colours == NULL) {
+		return 0;
+	}
+
+	return alphas[y * WIDTH + x];
+}
+
+///////////////////
+// COMPOSITOR
+///////////////////
+
+// Mix from one channel value to another; amount is from 0 (all from) to 255 (all to)
+static inline uint8_t mixChannel(uint8_t from, uint8_t to, uint8_t amount) {
+	uint16_t weight = amount + (amount >> 7);
+	return (from * (256 - weight) + to * weight) >> 8;
+}
+
+static inline uint8_t blendChannel(BlendMode mode, uint8_t below, uint8_t above) {
+	switch (mode) {
+		case BLEND_ADD:
+			return min(below + above, 255);
+		case BLEND_MULTIPLY:
+			return below * above / 255;
+		case BLEND_SCREEN:
+			return 255 - (255 - below) * (255 - above) / 255;
+		default:
+			return above;
+	}
+}
+
+Compositor::Compositor() {
+	mutex = xSemaphoreCreateMutex();
+}
+
+Compositor::Layer *Compositor::findLayer(AlphaCanvas *canvas) {
+	for (uint8_t i = 0; i < layerCount; i++) {
+		if (layers[i].canvas == canvas) {
+			return &layers[i];
+		}
+	}
+
+	return NULL;
+}
+
+void Compositor::markLayerDirty(const Layer &layer) {
+	dirty.add(layer.x, layer.y, layer.canvas->width(), layer.canvas->height());
+}
+
+bool Compositor::addLayer(AlphaCanvas *canvas, int16_t x, int16_t y, BlendMode mode, uint8_t opacity) {
+	xSemaphoreTake(mutex, portMAX_DELAY);
+
+	bool added = layerCount < MAX_LAYERS && findLayer(canvas) == NULL;
+
+	if (added) {
+		layers[layerCount] = {canvas, x, y, mode, opacity, true};
+		markLayerDirty(layers[layerCount]);
+		layerCount++;
+	} else {
+		Serial.println("Couldn't add a layer to the compositor");
+	}
+
+	xSemaphoreGive(mutex);
+	return added;
+}
+
+void Compositor::removeLayer(AlphaCanvas *canvas) {
+	xSemaphoreTake(mutex, portMAX_DELAY);
+
+	Layer *layer = findLayer(canvas);
+
+	if (layer != NULL) {
+		// Whatever was under the layer needs to be shown again
+		markLayerDirty(*layer);
+
+		// Keep the order of the layers above it
+		uint8_t index = layer - layers;
+		memmove(&layers[index], &layers[index + 1], (layerCount - index - 1) * sizeof(Layer));
+		layerCount--;
+	}
+
+	xSemaphoreGive(mutex);
+}
+
+void Compositor::moveLayer(AlphaCanvas *canvas, int16_t x, int16_t y) {
+	xSemaphoreTake(mutex, portMAX_DELAY);
+
+	Layer *layer = findLayer(canvas);
+
+	if (layer != NULL && (layer->x != x || layer->y != y)) {
+		markLayerDirty(*layer);
+		layer->x = x;
+		layer->y = y;
+		markLayerDirty(*layer);
+	}
+
+	xSemaphoreGive(mutex);
+}
+
+void Compositor::setLayerVisible(AlphaCanvas *canvas, bool visible) {
+	xSemaphoreTake(mutex, portMAX_DELAY);
+
+	Layer *layer = findLayer(canvas);
+
+	if (layer != NULL && layer->visible != visible) {
+		layer->visible = visible;
+		markLayerDirty(*layer);
+	}
+
+	xSemaphoreGive(mutex);
+}
+
+void Compositor::setLayerOpacity(AlphaCanvas *canvas, uint8_t opacity) {
+	xSemaphoreTake(mutex, portMAX_DELAY);
+
+	Layer *layer = findLayer(canvas);
+
+	if (layer != NULL && layer->opacity != opacity) {
+		layer->opacity = opacity;
+		markLayerDirty(*layer);
+	}
+
+	xSemaphoreGive(mutex);
+}
+
+void Compositor::setBase(const uint8_t *pixels) {
+	xSemaphoreTake(mutex, portMAX_DELAY);
+
+	if (base != pixels) {
+		base = pixels;
+		dirty.add(0, 0, PANEL_RES_X, PANEL_RES_Y);
+	}
+
+	xSemaphoreGive(mutex);
+}
+
+void Compositor::markBaseDirty() {
+	markBaseDirty(0, 0, PANEL_RES_X, PANEL_RES_Y);
+}
+
+void Compositor::markBaseDirty(int16_t x, int16_t y, int16_t w, int16_t h) {
+	xSemaphoreTake(mutex, portMAX_DELAY);
+	dirty.add(x, y, w, h);
+	xSemaphoreGive(mutex);
+}
+
+void Compositor::invalidate() {
+	xSemaphoreTake(mutex, portMAX_DELAY);
+	frameIsKnown = false;
+	xSemaphoreGive(mutex);
+}
+
+void Compositor::present() {
+	xSemaphoreTake(mutex, portMAX_DELAY);
+
+	// Gather up everything that's changed; changes to hidden layers don't matter, since showing a layer marks all of it dirty anyway
+	DirtyRect region = dirty;
+
+	for (uint8_t i = 0; i < layerCount; i++) {
+		if (layers[i].visible && layers[i].opacity > 0) {
+			region.add(layers[i].canvas->getDirtyRect(), layers[i].x, layers[i].y);
+		}
+
+		layers[i].canvas->clearDirtyRect();
+	}
+
+	dirty.clear();
+
+	int16_t x1 = max<int16_t>(region.x1, 0);
+	int16_t y1 = max<int16_t>(region.y1, 0);
+	int16_t x2 = min<int16_t>(region.x2, PANEL_RES_X - 1);
+	int16_t y2 = min<int16_t>(region.y2, PANEL_RES_Y - 1);
+
+	for (int16_t y = y1; y <= y2; y++) {
+		for (int16_t x = x1; x <= x2; x++) {
+			uint16_t index = (y * PANEL_RES_X + x) * 3;
+			uint8_t rgb[3] = {0, 0, 0};
+
+			if (base != NULL) {
+				memcpy(rgb, &base[index], 3);
+			}
+
+			for (uint8_t i = 0; i < layerCount; i++) {
+				const Layer &layer = layers[i];
+				int16_t canvasX = x - layer.x;
+				int16_t canvasY = y - layer.y;
+
+				if (!layer.visible || layer.canvas->colours == NULL || canvasX < 0 || canvasY < 0 || canvasX >= layer.canvas->width() || canvasY >= layer.canvas->height()) {
+					continue;
+				}
+
+				uint16_t pixel = canvasY * layer.canvas->width() + canvasX;
+				uint8_t alpha = layer.canvas->alphas[pixel] * layer.opacity / 255;
+
+				if (alpha == 0) {
+					continue;
+				}
+
+				// Expand RGB565 to RGB888, repeating the top bits so white stays white
+				uint16_t colour = layer.canvas->colours[pixel];
+				uint8_t r = (colour >> 11) & 0x1F, g = (colour >> 5) & 0x3F, b = colour & 0x1F;
+				uint8_t above[3] = {(uint8_t)((r << 3) | (r >> 2)), (uint8_t)((g << 2) | (g >> 4)), (uint8_t)((b << 3) | (b >> 2))};
+
+				for (uint8_t c = 0; c < 3; c++) {
+					rgb[c] = mixChannel(rgb[c], blendChannel(layer.mode, rgb[c], above[c]), alpha);
+				}
+			}
+
+			// Writing a pixel to the panel is far slower than checking it, so only the ones that have changed are written
+			if (!frameIsKnown || memcmp(&frame[index], rgb, 3) != 0) {
+				memcpy(&frame[index], rgb, 3);
+				dma_display->drawPixelRGB888(x, y, rgb[0], rgb[1], rgb[2]);
+			}
+		}
+	}
+
+	// Pixels outside the region weren't written, so they're only known if they already were
+	if (x1 == 0 && y1 == 0 && x2 == PANEL_RES_X - 1 && y2 == PANEL_RES_Y - 1) {
+		frameIsKnown = true;
+	}
+
+	xSemaphoreGive(mutex);
+}
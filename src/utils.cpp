@@ -77,13 +77,295 @@ bool verifyNTPServer(const char *ntpServer) {
 	return true;
 }
 
-void printCenteredText(const String &text, bool centerVertically) {
-	int16_t x1, y1;  // Variables to hold the top-left corner coordinates of the bounding box
-	uint16_t w, h;   // Variables to hold the width and height of the bounding box
+///////////////////
+// TEXT LAYOUT
+///////////////////
+// Adafruit GFX measures text by walking every glyph's bounds, and draws it one pixel at a time
+// Instead, each font's glyph metrics are cached the first time it's used, along with each glyph rasterised into horizontal runs
+// Runs are drawn with drawFastHLine(), which the DMA display writes straight into its buffer a row at a time
+#define GLYPH_CACHE_FONTS 4
+#define GLYPH_CACHE_GLYPHS 96
+#define GLYPH_RUN_POOL 1536
+
+// Adafruit GFX keeps the current font and text settings to itself; this reads them without changing the library
+struct GFXTextState : public Adafruit_GFX {
+	static const GFXfont *font(Adafruit_GFX *gfx) { return gfx->*(&GFXTextState::gfxFont); }
+	static uint16_t colour(Adafruit_GFX *gfx) { return gfx->*(&GFXTextState::textcolor); }
+	static uint8_t sizeX(Adafruit_GFX *gfx) { return gfx->*(&GFXTextState::textsize_x); }
+	static uint8_t sizeY(Adafruit_GFX *gfx) { return gfx->*(&GFXTextState::textsize_y); }
+	static bool wraps(Adafruit_GFX *gfx) { return gfx->*(&GFXTextState::wrap); }
+};
+
+// A horizontal line of lit pixels, relative to the cursor
+struct GlyphRun {
+	int8_t x;
+	int8_t y;
+	uint8_t length;
+};
+
+struct CachedGlyph {
+	uint16_t firstRun;
+	uint8_t runCount;
+	uint8_t width;
+	uint8_t height;
+	uint8_t advance;
+	int8_t xOffset;
+	int8_t yOffset;
+};
+
+struct CachedFont {
+	const GFXfont *font;
+	uint8_t first;
+	uint8_t last;
+	uint8_t yAdvance;
+	CachedGlyph glyphs[GLYPH_CACHE_GLYPHS];
+};
+
+CachedFont cachedFonts[GLYPH_CACHE_FONTS];
+uint8_t cachedFontCount = 0;
+
+GlyphRun glyphRuns[GLYPH_RUN_POOL];
+uint16_t glyphRunCount = 0;
+
+// Returns the cache entry for a font, building it if needed, or NULL if it can't be cached (in which case Adafruit GFX is used)
+const CachedFont *getCachedFont(const GFXfont *font) {
+	if (font == NULL) {
+		return NULL;
+	}
+
+	for (uint8_t i = 0; i < cachedFontCount; i++) {
+		if (cachedFonts[i].font == font) {
+			return &cachedFonts[i];
+		}
+	}
+
+	uint8_t first = pgm_read_byte(&font->first);
+	uint8_t last = pgm_read_byte(&font->last);
+
+	if (cachedFontCount == GLYPH_CACHE_FONTS || last - first + 1 > GLYPH_CACHE_GLYPHS) {
+		return NULL;
+	}
+
+	CachedFont &cached = cachedFonts[cachedFontCount];
+	uint16_t firstRun = glyphRunCount;
+
+	cached.font = font;
+	cached.first = first;
+	cached.last = last;
+	cached.yAdvance = pgm_read_byte(&font->yAdvance);
+
+	const uint8_t *bitmap = (const uint8_t *)pgm_read_ptr(&font->bitmap);
+
+	for (uint16_t c = first; c <= last; c++) {
+		const GFXglyph *glyph = &((GFXglyph *)pgm_read_ptr(&font->glyph))[c - first];
+		CachedGlyph &cachedGlyph = cached.glyphs[c - first];
+
+		cachedGlyph.width = pgm_read_byte(&glyph->width);
+		cachedGlyph.height = pgm_read_byte(&glyph->height);
+		cachedGlyph.advance = pgm_read_byte(&glyph->xAdvance);
+		cachedGlyph.xOffset = pgm_read_byte(&glyph->xOffset);
+		cachedGlyph.yOffset = pgm_read_byte(&glyph->yOffset);
+		cachedGlyph.firstRun = glyphRunCount;
+
+		// The bitmap is packed one bit per pixel, row after row, without padding between rows
+		uint16_t offset = pgm_read_word(&glyph->bitmapOffset);
+		uint8_t bits = 0, bit = 0;
+
+		for (int8_t y = 0; y < cachedGlyph.height; y++) {
+			int8_t runStart = -1;
+
+			for (int8_t x = 0; x <= cachedGlyph.width; x++) {
+				bool lit = false;
+
+				if (x < cachedGlyph.width) {
+					if (!(bit++ & 7)) {
+						bits = pgm_read_byte(&bitmap[offset++]);
+					}
+
+					lit = bits & 0x80;
+					bits <<= 1;
+				}
+
+				if (lit && runStart < 0) {
+					runStart = x;
+				} else if (!lit && runStart >= 0) {
+					// Out of room; give up on caching this font, and leave it to Adafruit GFX
+					if (glyphRunCount == GLYPH_RUN_POOL) {
+						glyphRunCount = firstRun;
+						return NULL;
+					}
+
+					glyphRuns[glyphRunCount++] = {(int8_t)(cachedGlyph.xOffset + runStart), (int8_t)(cachedGlyph.yOffset + y), (uint8_t)(x - runStart)};
+					runStart = -1;
+				}
+			}
+		}
+
+		cachedGlyph.runCount = glyphRunCount - cachedGlyph.firstRun;
+	}
+
+	cachedFontCount++;
+	return &cached;
+}
+
+// The same bounds getTextBounds() works out, for text on a single line (or several, split by '\n') without wrapping
+struct TextBounds {
+	int16_t x = 0;
+	int16_t y = 0;
+	int16_t minX = INT16_MAX;
+	int16_t minY = INT16_MAX;
+	int16_t maxX = -1;
+	int16_t maxY = -1;
+
+	void include(int16_t x1, int16_t y1, int16_t x2, int16_t y2) {
+		minX = min(minX, x1);
+		minY = min(minY, y1);
+		maxX = max(maxX, x2);
+		maxY = max(maxY, y2);
+	}
+
+	void add(const char *text, uint16_t length) {
+		const GFXfont *gfxFont = GFXTextState::font(dma_display);
+		const CachedFont *font = getCachedFont(gfxFont);
+		uint8_t sizeX = GFXTextState::sizeX(dma_display);
+		uint8_t sizeY = GFXTextState::sizeY(dma_display);
+
+		// A font that couldn't be cached is measured by Adafruit GFX, which is close enough for the rare times it happens
+		if (gfxFont != NULL && font == NULL) {
+			int16_t x1, y1;
+			uint16_t w, h;
+
+			dma_display->getTextBounds(String(text).substring(0, length), x, y, &x1, &y1, &w, &h);
+
+			if (w > 0) {
+				include(x1, y1, x1 + w - 1, y1 + h - 1);
+				x = x1 + w;
+			}
+
+			return;
+		}
+
+		for (uint16_t i = 0; i < length; i++) {
+			uint8_t c = text[i];
+
+			if (c == '\r') {
+				continue;
+			}
+
+			if (c == '\n') {
+				x = 0;
+				y += (font ? font->yAdvance : 8) * sizeY;
+				continue;
+			}
+
+			if (font == NULL) {
+				include(x, y, x + sizeX * 6 - 1, y + sizeY * 8 - 1);
+				x += sizeX * 6;
+			} else if (c >= font->first && c <= font->last) {
+				const CachedGlyph &glyph = font->glyphs[c - font->first];
+				int16_t x1 = x + glyph.xOffset * sizeX;
+				int16_t y1 = y + glyph.yOffset * sizeY;
+
+				include(x1, y1, x1 + glyph.width * sizeX - 1, y1 + glyph.height * sizeY - 1);
+				x += glyph.advance * sizeX;
+			}
+		}
+	}
+
+	uint16_t width() {
+		return maxX >= minX ? maxX - minX + 1 : 0;
+	}
+
+	uint16_t height() {
+		return maxY >= minY ? maxY - minY + 1 : 0;
+	}
+};
+
+uint16_t measureText(const char *text, uint16_t length, uint16_t *height) {
+	TextBounds bounds;
+	bounds.add(text, length);
+
+	if (height != NULL) {
+		*height = bounds.height();
+	}
+
+	return bounds.width();
+}
+
+uint16_t measureText(const String &text, uint16_t *height) {
+	return measureText(text.c_str(), text.length(), height);
+}
+
+// Prints at the cursor and moves it along, just like dma_display->print()
+void printText(const char *text, uint16_t length) {
+	const CachedFont *font = getCachedFont(GFXTextState::font(dma_display));
+
+	if (font == NULL) {
+		dma_display->write((const uint8_t *)text, length);
+		return;
+	}
+
+	uint16_t colour = GFXTextState::colour(dma_display);
+	uint8_t sizeX = GFXTextState::sizeX(dma_display);
+	uint8_t sizeY = GFXTextState::sizeY(dma_display);
+	bool wraps = GFXTextState::wraps(dma_display);
+
+	int16_t x = dma_display->getCursorX();
+	int16_t y = dma_display->getCursorY();
+
+	for (uint16_t i = 0; i < length; i++) {
+		uint8_t c = text[i];
+
+		if (c == '\r') {
+			continue;
+		}
 
-	// Use getTextBounds to get the size of your text
-	// Initial cursor position set to (0,0) for the calculation
-	dma_display->getTextBounds(text, 0, 0, &x1, &y1, &w, &h);
+		if (c == '\n') {
+			x = 0;
+			y += font->yAdvance * sizeY;
+			continue;
+		}
+
+		if (c < font->first || c > font->last) {
+			continue;
+		}
+
+		const CachedGlyph &glyph = font->glyphs[c - font->first];
+
+		if (glyph.width > 0 && glyph.height > 0) {
+			if (wraps && x + (glyph.xOffset + glyph.width) * sizeX > dma_display->width()) {
+				x = 0;
+				y += font->yAdvance * sizeY;
+			}
+
+			for (uint16_t r = glyph.firstRun; r < glyph.firstRun + glyph.runCount; r++) {
+				const GlyphRun &run = glyphRuns[r];
+
+				if (sizeX == 1 && sizeY == 1) {
+					dma_display->drawFastHLine(x + run.x, y + run.y, run.length, colour);
+				} else {
+					dma_display->fillRect(x + run.x * sizeX, y + run.y * sizeY, run.length * sizeX, sizeY, colour);
+				}
+			}
+		}
+
+		x += glyph.advance * sizeX;
+	}
+
+	dma_display->setCursor(x, y);
+}
+
+void printText(const char *text) {
+	printText(text, strlen(text));
+}
+
+void printText(const String &text) {
+	printText(text.c_str(), text.length());
+}
+
+void printCenteredText(const String &text, bool centerVertically) {
+	uint16_t h;
+	uint16_t w = measureText(text, &h);
 
 	// Calculate the starting position to center the text
 	int16_t centerX = (dma_display->width() - w) / 2;
@@ -101,7 +383,7 @@ void printCenteredText(const String &text, bool centerVertically) {
 	dma_display->setCursor(centerX, centerY);
 
 	// Print the text
-	dma_display->print(text);
+	printText(text);
 }
 
 void setTextColor(uint8_t r, uint8_t g, uint8_t b) {
@@ -109,12 +391,8 @@ void setTextColor(uint8_t r, uint8_t g, uint8_t b) {
 }
 
 void printCenteredTruncatedText(String text, uint16_t margin, String ellipsis) {
-	String truncatedText = text;
-
-	int16_t x1, y1;
-	uint16_t textWidth, textHeight;
-
-	bool truncationRequired = false;
+	const char *chars = text.c_str();
+	uint16_t length = text.length();
 
 	// Calculate maxWidth, taking the margin into account on both sides
 	uint16_t maxWidth = PANEL_RES_X - (margin * 2);
@@ -122,26 +400,42 @@ void printCenteredTruncatedText(String text, uint16_t margin, String ellipsis) {
 	// Use the current Y coordinate of the cursor
 	int16_t y = dma_display->getCursorY();
 
-	// Get the initial measurement of the text's rectangle
-	dma_display->getTextBounds(truncatedText, 0, y, &x1, &y1, &textWidth, &textHeight);
+	uint16_t textWidth = measureText(chars, length);
+	bool truncationRequired = textWidth > maxWidth && length > 1;
 
-	// While the text is wider than the max width, keep removing characters until it fits with the ellipsis
-	while (textWidth > maxWidth && truncatedText.length() > 1) {
-		truncatedText = truncatedText.substring(0, truncatedText.length() - 1);
+	// Binary search for the longest start of the text that fits with the ellipsis (keeping at least one character, as before)
+	if (truncationRequired) {
+		uint16_t low = 1, high = length - 1;
 
-		// Measure the text again, with the ellipsis, and set the truncationRequired flag
-		dma_display->getTextBounds(truncatedText + ellipsis, 0, y, &x1, &y1, &textWidth, &textHeight);
-		truncationRequired = true;
-	}
+		while (low < high) {
+			uint16_t mid = (low + high + 1) / 2;
 
-	// Add the ellipsis to the text, if necessary
-	if (truncationRequired) {
-		truncatedText += ellipsis;
+			TextBounds bounds;
+			bounds.add(chars, mid);
+			bounds.add(ellipsis.c_str(), ellipsis.length());
+
+			if (bounds.width() <= maxWidth) {
+				low = mid;
+			} else {
+				high = mid - 1;
+			}
+		}
+
+		length = low;
+
+		TextBounds bounds;
+		bounds.add(chars, length);
+		bounds.add(ellipsis.c_str(), ellipsis.length());
+		textWidth = bounds.width();
 	}
 
 	// Print the centered, potentially-truncated text to the panel
 	dma_display->setCursor((PANEL_RES_X - textWidth) / 2, y);
-	dma_display->print(truncatedText);
+	printText(chars, length);
+
+	if (truncationRequired) {
+		printText(ellipsis);
+	}
 }
 
 void getBH1750Readings() {
@@ -465,16 +759,12 @@ void runBackgroundTasks(void *pvParameters) {
 		static bool otaLoadingMessageShown;
 
 		if (otaUpdateInProgress) {
-			// If an OTA Update has just started, ensure the screen has been cleared before displaying the loading message
-			if (!otaLoadingMessageShown) {
-				dma_display->clearScreen();
-				otaLoadingMessageShown = true;
-			}
-
+			// The loading message is overlaid on whatever the app was showing, so there's no need to clear the screen first
+			otaLoadingMessageShown = true;
 			playOTALoadingAnimation();
 		} else if (!otaUpdateInProgress && otaLoadingMessageShown) {
-			// Clear the screen if an OTA update has been cancelled/is no longer in progress (unlikely but possible)
-			dma_display->clearScreen();
+			// Take the loading message away if an OTA update has been cancelled/is no longer in progress (unlikely but possible)
+			hideOTALoadingAnimation();
 			otaLoadingMessageShown = false;
 			vTaskDelay(100 / portTICK_PERIOD_MS);
 		}
@@ -1,5 +1,6 @@
 import hexToRgb from '../../lib/hexToRgb'
 import refreshAfterUpdate from '../../lib/refreshAfterUpdate.js'
+import {returnValidIntInRange} from '../../lib/returnValidIntInRange.js'
 import rgbToHex from '../../lib/rgbToHex.js'
 import APP_CONFIG_HTML from './pong-wars-settings.hbs'
 
@@ -29,21 +30,94 @@ export default function pongWarsConfig() {
 		window.currentSection = pongWarsSettings
 	})
 
-	const colour1 = window.fetchedConfig['pong-wars'].colour1
-	const colour2 = window.fetchedConfig['pong-wars'].colour2
+	const MIN_TEAMS = 2
+	const MAX_TEAMS = 8
 
-	const colour1Input = document.querySelector('#colour-1 > input')
-	const colour2Input = document.querySelector('#colour-2 > input')
+	// Older configs only have two colours
+	const fetchedPongWarsConfig = window.fetchedConfig['pong-wars']
+	const teams = fetchedPongWarsConfig.teams || [fetchedPongWarsConfig.colour1, fetchedPongWarsConfig.colour2]
+	let ballsPerTeam = fetchedPongWarsConfig.ballsPerTeam || 1
+	let squareSize = fetchedPongWarsConfig.squareSize || 2
 
-	colour1Input.value = rgbToHex(colour1)
-	colour2Input.value = rgbToHex(colour2)
+	const teamsWrapper = document.getElementById('teams-wrapper')
+	const addTeamButton = document.getElementById('add-team-button')
+	const ballsPerTeamInput = document.getElementById('balls-per-team')
+	const squareSizeInput = document.getElementById('square-size')
+
+	ballsPerTeamInput.value = ballsPerTeam
+	squareSizeInput.value = squareSize
+
+	ballsPerTeamInput.addEventListener('input', e => {
+		ballsPerTeam = returnValidIntInRange(e.target.value, 1, 4)
+		e.target.value = ballsPerTeam
+	})
+
+	squareSizeInput.addEventListener('input', e => {
+		squareSize = returnValidIntInRange(e.target.value, 1, 8)
+		e.target.value = squareSize
+	})
+
+	function updateTeamButtons() {
+		addTeamButton.disabled = teams.length >= MAX_TEAMS
+		teamsWrapper.querySelectorAll('.remove-team').forEach(button => {
+			button.disabled = teams.length <= MIN_TEAMS
+		})
+		teamsWrapper.querySelectorAll('.team-name').forEach((span, index) => {
+			span.innerHTML = `Team ${index + 1}`
+		})
+	}
+
+	function addTeam(colour) {
+		const teamWrapper = document.createElement('div')
+		teamWrapper.className = 'flex flex-col md:flex-row items-center gap-x-4'
+
+		const label = document.createElement('label')
+		label.className = 'flex flex-col text-center items-center'
+		label.innerHTML = '<span class="team-name ml-2"></span><input type="color" class="bg-black/50 text-white focus:bg-black/90 m-2 rounded-md p-1 h-20 w-28 block cursor-pointer"><div><span class="hex-display"></span></div>'
+
+		const input = label.querySelector('input')
+		const hexCodeDisplay = label.querySelector('.hex-display')
+		input.value = rgbToHex(colour)
+		hexCodeDisplay.innerHTML = input.value
+
+		input.addEventListener('input', e => {
+			hexCodeDisplay.innerHTML = e.target.value
+		})
+
+		const removeTeamButton = document.createElement('button')
+		removeTeamButton.className = 'remove-team inline-flex items-center py-1 px-2 gap-3 rounded-md bg-red-500/50 text-center shadow-md hover:bg-red-600 hover:shadow-inner transition-colors disabled:opacity-50 disabled:cursor-not-allowed'
+		removeTeamButton.innerHTML = 'Remove Team'
+
+		removeTeamButton.onclick = e => {
+			e.preventDefault()
+			teams.splice([...teamsWrapper.querySelectorAll('input')].indexOf(input), 1)
+			teamsWrapper.removeChild(teamWrapper)
+			updateTeamButtons()
+		}
+
+		teamWrapper.appendChild(label)
+		teamWrapper.appendChild(removeTeamButton)
+		teamsWrapper.appendChild(teamWrapper)
+	}
+
+	teams.forEach(colour => addTeam(colour))
+	updateTeamButtons()
+
+	addTeamButton.addEventListener('click', e => {
+		e.preventDefault()
+
+		teams.push({r: 255, g: 255, b: 255})
+		addTeam(teams[teams.length - 1])
+		updateTeamButtons()
+	})
 
 	appConfigElement.addEventListener('submit', async e => {
 		e.preventDefault()
 
 		try {
 			const formData = new FormData()
-			formData.append('colours', JSON.stringify({colour1: hexToRgb(colour1Input.value), colour2: hexToRgb(colour2Input.value)}))
+			const teamColours = [...teamsWrapper.querySelectorAll('input')].map(input => hexToRgb(input.value))
+			formData.append('pongWars', JSON.stringify({teams: teamColours, ballsPerTeam, squareSize}))
 			await fetch(`${window.API_URL}/config`, {method: 'POST', body: formData})
 			alert('Pong Wars Settings updated successfully! Please allow a moment for your Luxigrid to restart, and your changes will take effect.')
 			refreshAfterUpdate()
@@ -7,6 +7,9 @@ import hexToRgb from '../../lib/hexToRgb.js'
 import APP_CONFIG_HTML from './stock-ticker-settings.hbs'
 import refreshAfterUpdate from '../../lib/refreshAfterUpdate.js'
 
+// Must match MAX_STOCKS in apps/stock-ticker.hpp
+const MAX_STOCKS = 16
+
 export const APP_NAME = 'Stock Ticker'
 export const APP_BUTTON_NAME = 'Stock Ticker Settings'
 
@@ -128,7 +131,7 @@ export default function stockTickerConfig() {
 	const testStocksButton = document.querySelector('#test-stocks-button')
 	const stockTickerSettingsButton = document.querySelector('#stock-ticker-settings')
 
-	addStockButton.disabled = stocks?.length === 8
+	addStockButton.disabled = stocks?.length === MAX_STOCKS
 
 	function findStockByID(stockID) {
 		const stockIndex = stocks.findIndex(s => s.id === stockID)
@@ -245,7 +248,7 @@ export default function stockTickerConfig() {
 		})
 
 		addStock(stocks[stocks.length - 1])
-		addStockButton.disabled = stocks?.length === 8
+		addStockButton.disabled = stocks?.length === MAX_STOCKS
 	})
 
 	const testTicker = async ticker => {